@@ -0,0 +1,88 @@
+// binproto.c
+// Framing and CRC for the compact binary protocol.
+// This file is plain C so that the host-side tools can use it, too.
+//
+// 2026-10-18 First cut.
+
+#include <stdint.h>
+#include "binproto.h"
+
+uint8_t bp_crc8(uint8_t crc, uint8_t b)
+// CRC-8 with polynomial x^8+x^2+x+1, one byte at a time.
+// Bitwise rather than table-driven, to save flash.
+{
+    crc ^= b;
+    for (uint8_t i=0; i < 8; i++) {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+void bp_parser_reset(bp_parser_t* p)
+{
+    p->state = 0;
+    p->n = 0;
+    p->crc = 0;
+}
+
+uint8_t bp_parser_feed(bp_parser_t* p, uint8_t b)
+// Returns BP_FRAME_READY when a complete frame with good CRC
+// is available in p->opcode, p->len and p->payload.
+// A frame with bad CRC, or an impossible length, is dropped
+// and the parser goes back to hunting for a start byte.
+{
+    switch (p->state) {
+        case 0:
+            if (b == BP_START) {
+                p->state = 1;
+                p->crc = 0;
+                p->n = 0;
+            }
+            break;
+        case 1:
+            p->opcode = b;
+            p->crc = bp_crc8(p->crc, b);
+            p->state = 2;
+            break;
+        case 2:
+            if (b > BP_MAXPAYLOAD) {
+                bp_parser_reset(p);
+                break;
+            }
+            p->len = b;
+            p->crc = bp_crc8(p->crc, b);
+            p->state = (b > 0) ? 3 : 4;
+            break;
+        case 3:
+            p->payload[p->n] = b;
+            p->n++;
+            p->crc = bp_crc8(p->crc, b);
+            if (p->n >= p->len) p->state = 4;
+            break;
+        case 4:
+            p->state = 0;
+            if (b == p->crc) return BP_FRAME_READY;
+            return BP_FRAME_BADCRC;
+        default:
+            bp_parser_reset(p);
+    }
+    return BP_FRAME_NONE;
+}
+
+uint8_t bp_encode(uint8_t* buf, uint8_t opcode, const uint8_t* payload, uint8_t len)
+// Writes a complete frame into buf, which must have room for
+// len+BP_OVERHEAD bytes, and returns the number of bytes written.
+{
+    uint8_t crc = 0;
+    buf[0] = BP_START;
+    buf[1] = opcode;
+    buf[2] = len;
+    crc = bp_crc8(crc, opcode);
+    crc = bp_crc8(crc, len);
+    for (uint8_t i=0; i < len; i++) {
+        buf[3+i] = payload[i];
+        crc = bp_crc8(crc, payload[i]);
+    }
+    buf[3+len] = crc;
+    return (uint8_t)(len + BP_OVERHEAD);
+}
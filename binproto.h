@@ -0,0 +1,93 @@
+// binproto.h
+// Compact binary framing of the x2-timer commands,
+// shared by the firmware and the host-side tools.
+//
+// A frame is: BP_START opcode len payload[len] crc
+// where crc is the CRC-8 (polynomial 0x07, initial value 0)
+// of the opcode, len and payload bytes.
+// A reply carries the request opcode with BP_REPLY set and
+// its payload always starts with a status byte.
+// Register values are little-endian int16, as in the EEPROM.
+// Frames carry no node address, so the binary protocol is for
+// point-to-point links only: 'B' is refused while the node-address
+// register is non-zero, BP_OP_WRITE cannot set it, and a BP_OP_RESTORE
+// that brings back a non-zero address returns to the ASCII interpreter.
+//
+// 2026-10-18 First cut, mirroring the ASCII commands.
+//            Status record.
+//            Range error.
+//            Read-only error, arm flag 10.
+//            Ring overruns in the status record.
+//            Point-to-point only.
+
+#ifndef BINPROTO_H
+#define BINPROTO_H
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BP_START 0xA5
+#define BP_REPLY 0x80
+#define BP_MAXPAYLOAD 96
+// Start, opcode, len and crc bytes.
+#define BP_OVERHEAD 4
+
+// Opcodes and their request payloads.
+// Reply payloads follow the status byte.
+#define BP_OP_VERSION 0x01 // 'v' -> version text
+#define BP_OP_NUMREG  0x02 // 'n' -> n
+#define BP_OP_READALL 0x03 // 'p' -> n, n x int16
+#define BP_OP_READ    0x04 // 'r' i -> i, int16
+#define BP_OP_WRITE   0x05 // 's' i, int16 -> i, int16
+#define BP_OP_RESTORE 0x06 // 'R'
+#define BP_OP_SAVE    0x07 // 'S'
+#define BP_OP_FACTORY 0x08 // 'F'
+#define BP_OP_ARM     0x09 // 'a' -> mode, tof uint16, pr uint16
+#define BP_OP_ADC     0x0A // 'c' ch -> uint16
+// 'x' -> armed, mode, flag, tof uint16, pr uint16, shots uint16,
+// uptime uint32 (4.096ms ticks), reset cause, framing errors uint16,
+// FIFO overflows uint16, over-long lines uint16, ring overruns uint16
+#define BP_OP_STATUS  0x0B
+#define BP_OP_EXIT    0x7F // return to the ASCII interpreter
+
+// Status byte values.
+// For BP_OP_ARM, the nonzero values 1-10 are the flags
+// returned by trigger_simple() and trigger_TOF();
+// 10 means the Event4 or Event5 settings do not fit
+// (they clash with a delay or cannot reach their outputs).
+#define BP_OK           0x00
+#define BP_ERR_REGISTER 0xF0 // register index out of range
+#define BP_ERR_LENGTH   0xF1 // wrong payload length for opcode
+#define BP_ERR_CRC      0xF2 // frame arrived with bad CRC
+#define BP_ERR_OPCODE   0xF3 // unknown opcode
+#define BP_ERR_CHANNEL  0xF4 // ADC channel not allowed
+#define BP_ERR_MODE     0xF5 // unknown trigger mode
+#define BP_ERR_RANGE    0xF6 // value outside the register's range
+#define BP_ERR_READONLY 0xF7 // register not writable, e.g. the baud code or node address
+
+// Results of feeding a byte to the parser.
+#define BP_FRAME_NONE   0
+#define BP_FRAME_READY  1
+#define BP_FRAME_BADCRC 2
+
+typedef struct {
+    uint8_t state; // 0=hunting for start, 1=opcode, 2=len, 3=payload, 4=crc
+    uint8_t opcode;
+    uint8_t len;
+    uint8_t n;
+    uint8_t crc;
+    uint8_t payload[BP_MAXPAYLOAD];
+} bp_parser_t;
+
+uint8_t bp_crc8(uint8_t crc, uint8_t b);
+void bp_parser_reset(bp_parser_t* p);
+uint8_t bp_parser_feed(bp_parser_t* p, uint8_t b);
+uint8_t bp_encode(uint8_t* buf, uint8_t opcode, const uint8_t* payload, uint8_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
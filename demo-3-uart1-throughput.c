@@ -0,0 +1,171 @@
+// demo-3-uart1-throughput.c
+// Measure the sustained transmit throughput of UART1 at each
+// of the baud rates offered by the x2-timer firmware.
+// Built from demo-2-uart1.c, with the same uart.c and its DMA transmit path.
+//
+// At each rate, the MCU announces the rate at 115200 baud, switches,
+// and waits up to 5 s for the host to send the line "g" at the new rate.
+// It then sends NBLOCKS lines of text, timing the transfer with Timer0,
+// and reports the sustained bytes per second, still at the new rate.
+// Hardware flow control means that the figure includes any
+// holding-off by the host, which is what we want to know.
+//
+// 2026-10-18 First cut.
+//
+// PIC18F46Q71 Configuration Bit Settings (generated in Memory View)
+// CONFIG1
+#pragma config FEXTOSC = OFF
+#pragma config RSTOSC = HFINTOSC_64MHZ
+
+// CONFIG2
+#pragma config CLKOUTEN = OFF
+#pragma config PR1WAY = OFF
+#pragma config BBEN = OFF
+#pragma config CSWEN = OFF
+#pragma config FCMEN = OFF
+#pragma config FCMENP = OFF
+#pragma config FCMENS = OFF
+
+// CONFIG3
+#pragma config MCLRE = EXTMCLR
+#pragma config PWRTS = PWRT_64
+#pragma config MVECEN = OFF
+#pragma config IVT1WAY = OFF
+#pragma config LPBOREN = OFF
+#pragma config BOREN = SBORDIS
+
+// CONFIG4
+#pragma config BORV = VBOR_1P9
+#pragma config ZCD = OFF
+#pragma config PPS1WAY = OFF
+#pragma config STVREN = ON
+#pragma config LVP = ON
+#pragma config DEBUG = OFF
+#pragma config XINST = OFF
+
+// CONFIG5
+#pragma config WDTCPS = WDTCPS_31
+#pragma config WDTE = ON
+
+// CONFIG6
+#pragma config WDTCWS = WDTCWS_7
+#pragma config WDTCCS = SC
+
+// CONFIG7
+// BBSIZE = No Setting
+
+// CONFIG8
+#pragma config SAFSZ = SAFSZ_NONE
+
+// CONFIG9
+#pragma config WRTB = OFF
+#pragma config WRTC = OFF
+#pragma config WRTD = OFF
+#pragma config WRTSAF = OFF
+#pragma config WRTAPP = OFF
+
+// CONFIG10
+#pragma config CPD = OFF
+
+// CONFIG11
+#pragma config CP = OFF
+
+#include <xc.h>
+#include "global_defs.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "uart.h"
+#include <stdio.h>
+#include <string.h>
+
+#define GREENLED LATEbits.LATE0
+
+#define NBUF 80 
+char buf[NBUF];
+
+#define NRATES 7
+const long rates[NRATES] = {115200, 230400, 460800, 500000,
+    1000000, 2000000, 4000000};
+
+// Each line is 64 characters, including the CR-LF.
+#define NBLOCKS 256
+const char line[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ\r\n";
+
+void timer0_init(void)
+{
+    // Free-running 16-bit count of FOSC/4/256, giving 16us ticks
+    // and a roll-over period of 1.05s.
+    T0CON0bits.EN = 0;
+    T0CON0bits.MD16 = 1;
+    T0CON1bits.CS = 0b010; // FOSC/4
+    T0CON1bits.ASYNC = 0;
+    T0CON1bits.CKPS = 0b1000; // 1:256
+    TMR0H = 0;
+    TMR0L = 0;
+    T0CON0bits.EN = 1;
+}
+
+uint16_t timer0_read(void)
+{
+    uint8_t low = TMR0L; // reading TMR0L latches TMR0H
+    return (uint16_t)((TMR0H << 8) | low);
+}
+
+uint8_t wait_for_go(void)
+// Returns 1 if the host sent "g" within 5 seconds.
+{
+    for (uint16_t t=0; t < 5000; t++) {
+        if (uart1_line_ready()) {
+            getstr(buf, NBUF);
+            if (strcmp(buf, "g") == 0) return 1;
+        }
+        __delay_ms(1);
+        CLRWDT();
+    }
+    return 0;
+}
+
+int main(void)
+{
+    TRISEbits.TRISE0 = 0; // Pin as output for GREENLED.
+    GREENLED = 0;
+    uart1_init(115200);
+    timer0_init();
+    __delay_ms(10);
+    printf("PIC18F46Q71 UART1 throughput benchmark\r\n");
+    for (uint8_t r=0; r < NRATES; r++) {
+        GREENLED ^= 1;
+        printf("next %ld\r\n", rates[r]);
+        uart1_set_baud(rates[r]);
+        if (!wait_for_go()) {
+            uart1_set_baud(115200);
+            printf("rate %ld skipped\r\n", rates[r]);
+            continue;
+        }
+        // Queuing a block waits, at most, for a ring-buffer's worth
+        // of characters to go, which is much less than the timer roll-over,
+        // so summing the 16-bit differences gives the full elapsed time.
+        uint32_t ticks = 0;
+        uint16_t t0 = timer0_read();
+        uint16_t t1;
+        for (uint16_t b=0; b < NBLOCKS; b++) {
+            putstr(line);
+            t1 = timer0_read();
+            ticks += (uint16_t)(t1 - t0);
+            t0 = t1;
+        }
+        uart1_tx_flush();
+        t1 = timer0_read();
+        ticks += (uint16_t)(t1 - t0);
+        uint32_t nbytes = (uint32_t)NBLOCKS * (sizeof(line) - 1);
+        uint32_t us = ticks * 16;
+        // 62500 ticks per second; nbytes*62500 fits within 32 bits.
+        uint32_t bytes_per_s = (ticks > 0) ? (nbytes * 62500UL) / ticks : 0;
+        printf("rate %ld: %lu bytes in %lu us, %lu bytes/s\r\n", rates[r], nbytes, us, bytes_per_s);
+        uart1_set_baud(115200);
+    }
+    printf("done\r\n");
+    uart1_close();
+    return 0; // Expect that the MCU will reset.
+} // end main
@@ -1,9 +1,11 @@
 // eeprom.c Code generated by MCC for PIC18F26Q10 
 // and then placed into this file by PJ.
 // 2024-07-13 Adapted to PIC18F46Q71 using description in data sheet.
+// 2026-10-18 Keep the profiling clock going through the write.
 
 #include <xc.h>
 #include <stdint.h>
+#include "profile.h"
 
 void DATAEE_WriteByte(uint16_t bAdd, uint8_t bData)
 // See PIC18F46Q71 data sheet, section 10.4.2, Example 10-10
@@ -29,7 +31,7 @@ void DATAEE_WriteByte(uint16_t bAdd, uint8_t bData)
     //Start DATAEE write and wait for the operation to complete
     NVMCON1bits.CMD = 0b011;
     NVMCON0bits.GO = 1;
-    while (NVMCON0bits.GO) /* wait */ ;
+    while (NVMCON0bits.GO) { PROFILE_SERVICE(); } // a write takes milliseconds
     //
     // Restore all the interrupts
     INTCON0bits.GIE = GIEBitValue;
@@ -3,5 +3,8 @@
 #ifndef GLOBAL_DEFS
 #define FOSC 64000000L
 #define _XTAL_FREQ FOSC
+// Define RS485 for a node on a multidrop bus with a half-duplex
+// transceiver (e.g. MAX3082) rather than the TTL-232 cable with RTS/CTS.
+// #define RS485
 #define GLOBAL_DEFS
 #endif
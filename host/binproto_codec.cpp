@@ -0,0 +1,85 @@
+// binproto_codec.cpp
+// 2026-10-18 First cut.
+
+#include "binproto_codec.hpp"
+
+namespace x2 {
+
+std::int16_t Frame::i16(std::size_t offset) const
+{
+    return static_cast<std::int16_t>(u16(offset));
+}
+
+std::uint16_t Frame::u16(std::size_t offset) const
+{
+    if (offset + 1 >= payload.size()) return 0;
+    return static_cast<std::uint16_t>(payload[offset] | (payload[offset + 1] << 8));
+}
+
+std::vector<std::uint8_t> encode_frame(std::uint8_t opcode, const std::vector<std::uint8_t>& payload)
+{
+    std::vector<std::uint8_t> buf(payload.size() + BP_OVERHEAD);
+    std::uint8_t n = bp_encode(buf.data(), opcode, payload.data(),
+                               static_cast<std::uint8_t>(payload.size()));
+    buf.resize(n);
+    return buf;
+}
+
+std::vector<std::uint8_t> encode_read(std::uint8_t reg)
+{
+    return encode_frame(BP_OP_READ, {reg});
+}
+
+std::vector<std::uint8_t> encode_write(std::uint8_t reg, std::int16_t value)
+{
+    auto v = static_cast<std::uint16_t>(value);
+    return encode_frame(BP_OP_WRITE, {reg, static_cast<std::uint8_t>(v & 0xFF),
+                                      static_cast<std::uint8_t>(v >> 8)});
+}
+
+std::vector<std::uint8_t> encode_adc(std::uint8_t channel)
+{
+    return encode_frame(BP_OP_ADC, {channel});
+}
+
+FrameDecoder::FrameDecoder() : bad_crc_(0)
+{
+    bp_parser_reset(&parser_);
+}
+
+void FrameDecoder::reset()
+{
+    bp_parser_reset(&parser_);
+}
+
+std::optional<Frame> FrameDecoder::feed(std::uint8_t b)
+{
+    std::uint8_t r = bp_parser_feed(&parser_, b);
+    if (r == BP_FRAME_BADCRC) {
+        ++bad_crc_;
+        return std::nullopt;
+    }
+    if (r != BP_FRAME_READY) return std::nullopt;
+    Frame f;
+    f.opcode = parser_.opcode;
+    f.payload.assign(parser_.payload, parser_.payload + parser_.len);
+    return f;
+}
+
+std::string status_text(std::uint8_t status)
+{
+    switch (status) {
+        case BP_OK: return "ok";
+        case BP_ERR_REGISTER: return "register out of range";
+        case BP_ERR_LENGTH: return "bad payload length";
+        case BP_ERR_CRC: return "bad CRC";
+        case BP_ERR_OPCODE: return "unknown opcode";
+        case BP_ERR_CHANNEL: return "ADC channel not allowed";
+        case BP_ERR_MODE: return "unknown trigger mode";
+        case BP_ERR_RANGE: return "value out of range";
+        case BP_ERR_READONLY: return "register is read-only";
+        default: return "trigger flag " + std::to_string(status);
+    }
+}
+
+} // namespace x2
@@ -0,0 +1,56 @@
+// binproto_codec.hpp
+// Host-side encoder and decoder for the binary protocol in ../binproto.h.
+// The framing and CRC code is shared with the firmware.
+//
+// 2026-10-18 First cut.
+
+#ifndef X2_BINPROTO_CODEC_HPP
+#define X2_BINPROTO_CODEC_HPP
+
+#include "binproto.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace x2 {
+
+struct Frame {
+    std::uint8_t opcode = 0;
+    std::vector<std::uint8_t> payload;
+
+    bool is_reply() const { return (opcode & BP_REPLY) != 0; }
+    // For replies, the first payload byte is the status.
+    std::uint8_t status() const { return payload.empty() ? BP_ERR_LENGTH : payload[0]; }
+    // Little-endian 16-bit value at the given payload offset.
+    std::int16_t i16(std::size_t offset) const;
+    std::uint16_t u16(std::size_t offset) const;
+};
+
+std::vector<std::uint8_t> encode_frame(std::uint8_t opcode, const std::vector<std::uint8_t>& payload = {});
+
+// Convenience encoders for the requests.
+std::vector<std::uint8_t> encode_read(std::uint8_t reg);
+std::vector<std::uint8_t> encode_write(std::uint8_t reg, std::int16_t value);
+std::vector<std::uint8_t> encode_adc(std::uint8_t channel);
+
+class FrameDecoder {
+public:
+    FrameDecoder();
+    // Feeds one byte; returns a frame once one has arrived with a good CRC.
+    // Frames with a bad CRC are counted and dropped.
+    std::optional<Frame> feed(std::uint8_t b);
+    unsigned bad_crc_count() const { return bad_crc_; }
+    void reset();
+
+private:
+    bp_parser_t parser_;
+    unsigned bad_crc_;
+};
+
+std::string status_text(std::uint8_t status);
+
+} // namespace x2
+
+#endif
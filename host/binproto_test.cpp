@@ -0,0 +1,99 @@
+// binproto_test.cpp
+// Round trip of the binary protocol through the host encoder and the
+// frame parser that the firmware shares, without a node.
+// Run by 'make check'; exits nonzero if anything does not survive.
+//
+// 2026-10-18 First cut.
+
+#include "binproto_codec.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+    if (!ok && failures++ < 10) std::fprintf(stderr, "binproto_test: %s\n", what);
+}
+
+std::vector<x2::Frame> decode(const std::vector<std::uint8_t>& bytes, x2::FrameDecoder& d)
+{
+    std::vector<x2::Frame> frames;
+    for (auto b : bytes) {
+        if (auto f = d.feed(b)) frames.push_back(*f);
+    }
+    return frames;
+}
+
+bool same(const x2::Frame& f, std::uint8_t opcode, const std::vector<std::uint8_t>& payload)
+{
+    return f.opcode == opcode && f.payload == payload;
+}
+
+} // namespace
+
+int main()
+{
+    // Every payload length, with each byte value appearing,
+    // including the start byte inside the payload.
+    std::uint32_t x = 1;
+    for (unsigned len = 0; len <= BP_MAXPAYLOAD; ++len) {
+        std::vector<std::uint8_t> payload(len);
+        for (auto& b : payload) {
+            x = x * 1664525u + 1013904223u;
+            b = static_cast<std::uint8_t>(x >> 24);
+        }
+        if (len > 0) payload[0] = BP_START;
+        std::uint8_t opcode = static_cast<std::uint8_t>(len % 2 ? BP_OP_WRITE | BP_REPLY : BP_OP_READALL);
+        auto bytes = x2::encode_frame(opcode, payload);
+        check(bytes.size() == len + BP_OVERHEAD, "frame size");
+        check(bytes.size() > 0 && bytes[0] == BP_START, "start byte");
+        x2::FrameDecoder d;
+        auto frames = decode(bytes, d);
+        check(frames.size() == 1 && same(frames[0], opcode, payload), "round trip");
+        check(d.bad_crc_count() == 0, "no bad CRC");
+    }
+
+    // Register requests, as the firmware expects them.
+    auto w = x2::encode_write(21, -2);
+    check(w.size() == 3 + BP_OVERHEAD && w[1] == BP_OP_WRITE && w[2] == 3 &&
+          w[3] == 21 && w[4] == 0xFE && w[5] == 0xFF, "write request layout");
+    x2::FrameDecoder d;
+    auto frames = decode(w, d);
+    check(frames.size() == 1 && frames[0].payload.size() == 3, "write request");
+    if (frames.size() == 1) {
+        x2::Frame f = frames[0];
+        f.payload.erase(f.payload.begin()); // as if the register were the status
+        check(f.i16(0) == -2 && f.u16(0) == 0xFFFE, "little-endian value");
+    }
+
+    // A corrupted byte is counted and dropped, and the next frame still comes.
+    auto r = x2::encode_read(3);
+    std::vector<std::uint8_t> stream = {0x00, 0x13, BP_REPLY}; // noise first
+    auto bad = r;
+    bad[3] ^= 0x40;
+    stream.insert(stream.end(), bad.begin(), bad.end());
+    stream.insert(stream.end(), r.begin(), r.end());
+    auto a = x2::encode_adc(9);
+    stream.insert(stream.end(), a.begin(), a.end());
+    d.reset();
+    frames = decode(stream, d);
+    check(d.bad_crc_count() == 1, "bad CRC counted");
+    check(frames.size() == 2 && same(frames[0], BP_OP_READ, {3}) &&
+          same(frames[1], BP_OP_ADC, {9}), "frames after a bad one");
+
+    // Status texts for the error codes.
+    check(x2::status_text(BP_ERR_RANGE) == "value out of range", "range status");
+    check(x2::status_text(BP_ERR_READONLY) == "register is read-only", "read-only status");
+    check(x2::status_text(10) == "trigger flag 10", "trigger flag status");
+
+    if (failures) {
+        std::fprintf(stderr, "binproto_test: %d failures\n", failures);
+        return 1;
+    }
+    std::printf("binproto_test: all frames round trip\n");
+    return 0;
+}
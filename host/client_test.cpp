@@ -0,0 +1,203 @@
+// client_test.cpp
+// Checks the supervisory client library: first the reply assembly and
+// parsing on canned replies, then a round trip of each kind of request
+// against the firmware running in x2-emulator, on a pty.
+// Run by 'make check', from this directory; exits nonzero on failure.
+//
+// 2026-10-18 First cut.
+
+#include "x2client.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+    if (!ok && failures++ < 20) std::fprintf(stderr, "client_test: %s\n", what.c_str());
+}
+
+x2::Reply assemble(const std::string& tag, const std::string& text)
+{
+    x2::ReplyAssembler a;
+    a.expect(tag);
+    for (char c : text) {
+        if (auto r = a.feed(c)) return *r;
+    }
+    return x2::Reply();
+}
+
+void offline_checks()
+{
+    check(x2::format_command("r 4", 0, "7") == "#7 r 4\r", "format_command, point-to-point");
+    check(x2::format_command("x", 3, "8") == "@3 #8 x\r", "format_command, addressed");
+
+    // A stale reply, then ours in several lines.
+    x2::Reply r = assemble("12", "#11 reg[4] 5 (delay-0) ok\r\n"
+                                 "#12 Register values:\r\nreg[4]=40000 (delay-0)\r\n"
+                                 "reg[7]=-1234 (clock-corr-ppm)\r\nok\r\n");
+    check(r.ok && r.lines.size() == 4, "reply after a stale one");
+    auto regs = x2::parse_registers(r);
+    check(regs.size() == 8 && regs[4] == 40000 && regs[7] == -1234, "parse_registers");
+
+    check(x2::parse_register(assemble("1", "#1 40000 (delay-0) ok\n")) == 40000, "parse_register, r");
+    check(x2::parse_register(assemble("1", "@2 #1 reg[4] 65535 (delay-0) ok\n")) == 65535,
+          "parse_register, s");
+    x2::Reply fail = assemble("1", "#1 delay-0 out of range. fail\n");
+    check(!fail.ok, "fail reply");
+    try {
+        x2::parse_register(fail);
+        check(false, "parse_register should throw on fail");
+    } catch (const x2::CommandError&) {
+    }
+    check(assemble("5", "#5 Error, no command\n").lines.size() == 1, "error line ends a reply");
+    check(x2::parse_version(assemble("3", "#3 v0.33 PIC18F46Q71\n")) == "v0.33 PIC18F46Q71",
+          "version without ok");
+
+    x2::Status st = x2::parse_status(
+        assemble("4", "#4 1 1 00 0C80 FFF6 0003 000012A4 1 0002 0000 0001 0005 ok\n"));
+    check(st.armed && st.mode == 1 && st.tof == 0x0C80 && st.pr == -10 && st.shots == 3 &&
+          st.uptime_ticks == 0x12A4 && st.framing_errors == 2 && st.long_lines == 1 &&
+          st.ring_overruns == 5, "parse_status");
+    st = x2::parse_status(assemble("4", "#4 0 0 FF 0000 0000 0000 00000010 1 0000 0000 0000 ok\n"));
+    check(!st.armed && st.ring_overruns == 0, "parse_status, eleven fields");
+
+    x2::ArmResult a = x2::parse_arm(assemble("6",
+        "#6 Armed TOF trigger: tof=100 pr=425 ev4=300 jitter-ns=781 triggered. ok\n"));
+    check(a.triggered && a.tof == 100 && a.pr == 425 && a.ev4 == 300 && !a.ev5 &&
+          a.jitter_ns == 781, "parse_arm");
+    x2::ArmAck ack = x2::parse_arm_ack("armed 1234 ok");
+    check(ack.armed && ack.latency_us == 1234, "parse_arm_ack");
+}
+
+// The emulator, on a pty whose path it prints first.
+struct Emulator {
+    pid_t pid = -1;
+    std::string tty;
+
+    bool start()
+    {
+        int out[2];
+        if (pipe(out)) return false;
+        pid = fork();
+        if (pid < 0) return false;
+        if (pid == 0) {
+            dup2(out[1], 1);
+            int null = open("/dev/null", O_WRONLY);
+            if (null >= 0) dup2(null, 2);
+            close(out[0]);
+            execl("./x2-emulator", "x2-emulator", "-s", "emulator/example-shot.txt", (char*)nullptr);
+            _exit(127);
+        }
+        close(out[1]);
+        char c;
+        while (read(out[0], &c, 1) == 1 && c != '\n') tty += c;
+        close(out[0]);
+        return !tty.empty();
+    }
+
+    ~Emulator()
+    {
+        if (pid > 0) {
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+        }
+    }
+};
+
+bool wait_until_idle(x2::Node& node)
+{
+    for (int k = 0; k < 50; ++k) {
+        if (!node.status().armed) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+}
+
+void emulator_checks()
+{
+    Emulator emu;
+    if (!emu.start()) {
+        check(false, "cannot start ./x2-emulator");
+        return;
+    }
+    auto port = std::make_shared<x2::SerialPort>(emu.tty, 115200);
+    x2::Node node(port, 0, 1000);
+    // The firmware takes a while to start; replies to stale tags are ignored.
+    std::string version;
+    for (int k = 0; k < 20 && version.empty(); ++k) {
+        try {
+            version = node.version();
+        } catch (const x2::TimeoutError&) {
+        }
+    }
+    check(version.compare(0, 2, "v0") == 0, "version: " + version);
+    if (version.empty()) return;
+
+    node.set_original_values();
+    check(node.num_registers() == static_cast<int>(node.registers().size()), "numreg and regs");
+    check(node.write_register(4, 40000) == 40000, "write an unsigned register");
+    check(node.read_register(4) == 40000, "read an unsigned register");
+    check(node.registers().at(4) == 40000, "regs, unsigned");
+    check(node.write_register(7, -1234) == -1234, "write a signed register");
+    check(node.read_register(7) == -1234, "read a signed register");
+    try {
+        node.write_register(9, 1);
+        check(false, "the baud code should be read-only");
+    } catch (const x2::CommandError&) {
+    }
+    node.set_original_values();
+
+    // Several requests through the poller, in order on the one port.
+    x2::Poller poller;
+    auto results = poller.run({{&node, "v"}, {&node, "r 4"}, {&node, "x"}});
+    check(results.size() == 3 && results[0].reply && results[1].reply && results[2].reply,
+          "poller replies");
+    if (results.size() == 3 && results[1].reply && results[2].reply) {
+        check(x2::parse_register(*results[1].reply) == 0, "poller read");
+        check(!x2::parse_status(*results[2].reply).armed, "poller status");
+    }
+
+    // Arm and let the script's event end the shot, then the same
+    // with the broadcast early-acknowledged arm.
+    node.write_register(1, 64); // level-a, 1.024V
+    node.write_register(2, 64);
+    x2::ArmResult a = node.arm(2000);
+    check(a.triggered, "arm: " + a.message);
+    auto acks = x2::broadcast_arm({&node}, 2000);
+    check(acks.size() == 1 && acks[0] && acks[0]->armed,
+          "broadcast arm: " + (acks.size() == 1 && acks[0] ? acks[0]->message : std::string("none")));
+    check(wait_until_idle(node), "idle after the broadcast arm");
+    x2::Status st = node.status();
+    check(st.shots == 2 && st.flag == 0, "two good shots");
+    node.set_original_values();
+}
+
+} // namespace
+
+int main()
+{
+    offline_checks();
+    try {
+        emulator_checks();
+    } catch (const std::exception& e) {
+        check(false, e.what());
+    }
+    if (failures) {
+        std::fprintf(stderr, "client_test: %d failures\n", failures);
+        return 1;
+    }
+    std::printf("client_test: all requests round trip through the emulator\n");
+    return 0;
+}
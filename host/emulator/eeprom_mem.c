@@ -0,0 +1,77 @@
+// eeprom_mem.c
+// Data EEPROM for the emulator, in place of eeprom.c.
+// The image starts from the firmware's __EEPROM_DATA lines and,
+// if a backing file is given, from that file, which is rewritten
+// after every byte write so that settings survive a restart.
+//
+// 2026-10-18 First cut.
+//            Probe clock read after each write, as eeprom.c does while waiting.
+
+#include <xc.h>
+#include "eeprom.h"
+#include "model.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint8_t emu_eeprom[EMU_EEPROM_SIZE];
+
+// The __EEPROM_DATA constructors may run in any order,
+// so the blocks are kept with their source line until placed.
+#define NBLOCKS (EMU_EEPROM_SIZE / 8)
+static struct { int line; uint8_t b[8]; } blocks[NBLOCKS];
+static int nblocks = 0;
+static const char* backing_path = NULL;
+
+void emu_eeprom_data(int line, uint8_t a, uint8_t b, uint8_t c, uint8_t d,
+                     uint8_t e, uint8_t f, uint8_t g, uint8_t h)
+{
+    if (nblocks == NBLOCKS) return;
+    uint8_t v[8] = {a, b, c, d, e, f, g, h};
+    blocks[nblocks].line = line;
+    memcpy(blocks[nblocks].b, v, 8);
+    nblocks++;
+}
+
+static int compare_lines(const void* a, const void* b)
+{
+    return ((const int*)a)[0] - ((const int*)b)[0];
+}
+
+int emu_eeprom_load(const char* path)
+{
+    memset(emu_eeprom, 0xff, sizeof(emu_eeprom)); // erased state
+    qsort(blocks, nblocks, sizeof(blocks[0]), compare_lines);
+    for (int i = 0; i < nblocks; i++) memcpy(&emu_eeprom[8*i], blocks[i].b, 8);
+    backing_path = path;
+    if (!path) return 0;
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0; // created on the first write
+    size_t n = fread(emu_eeprom, 1, sizeof(emu_eeprom), f);
+    fclose(f);
+    return (n == sizeof(emu_eeprom)) ? 0 : 1;
+}
+
+void emu_eeprom_store(void)
+{
+    if (!backing_path) return;
+    FILE* f = fopen(backing_path, "wb");
+    if (!f) { perror(backing_path); return; }
+    fwrite(emu_eeprom, 1, sizeof(emu_eeprom), f);
+    fclose(f);
+}
+
+void DATAEE_WriteByte(uint16_t bAdd, uint8_t bData)
+{
+    // A byte write takes about 4ms on the real device.
+    emu_delay_ticks(4 * 8000u);
+    PROFILE_SERVICE();
+    emu_eeprom[bAdd % EMU_EEPROM_SIZE] = bData;
+    emu_eeprom_store();
+}
+
+uint8_t DATAEE_ReadByte(uint16_t bAdd)
+{
+    return emu_eeprom[bAdd % EMU_EEPROM_SIZE];
+}
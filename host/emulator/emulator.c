@@ -0,0 +1,77 @@
+// emulator.c
+// Run the x2-timer firmware on the host, talking through a pseudo-terminal,
+// so that the host tools can be exercised end to end without hardware.
+//
+// Usage: x2-emulator [-l link] [-e eeprom-file] [-f flash-file] [-s script-file]
+//   -l  also make a symbolic link to the pty, e.g. /tmp/x2-tty
+//   -e  keep the data EEPROM in this file across runs
+//   -f  keep the Storage Area Flash (shot journal) in this file
+//   -s  replay analog input steps after each arming (see model.h)
+// The pty path is printed on stdout; each shot is reported on stderr.
+//
+// 2026-10-18 First cut.
+//            Storage Area Flash file.
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <xc.h>
+#include "model.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+int firmware_main(void);
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: x2-emulator [-l link] [-e eeprom-file] [-f flash-file] [-s script-file]\n");
+    exit(2);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* link_path = NULL;
+    const char* eeprom_path = NULL;
+    const char* saf_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "l:e:f:s:")) != -1) {
+        switch (opt) {
+        case 'l': link_path = optarg; break;
+        case 'e': eeprom_path = optarg; break;
+        case 'f': saf_path = optarg; break;
+        case 's': if (emu_load_script(optarg)) return 1; break;
+        default: usage();
+        }
+    }
+    if (emu_eeprom_load(eeprom_path)) {
+        fprintf(stderr, "%s: short EEPROM image\n", eeprom_path);
+        return 1;
+    }
+    if (emu_saf_load(saf_path)) {
+        fprintf(stderr, "%s: short flash image\n", saf_path);
+        return 1;
+    }
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) || unlockpt(fd)) { perror("pty"); return 1; }
+    const char* name = ptsname(fd);
+    // Hold the slave side open so that clients may come and go,
+    // and make it raw so that bytes pass unchanged.
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0) { perror(name); return 1; }
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (link_path) {
+        unlink(link_path);
+        if (symlink(name, link_path)) { perror(link_path); return 1; }
+    }
+    printf("%s\n", name);
+    fflush(stdout);
+    emu_uart_attach(fd);
+    emu_init(stderr);
+    return firmware_main();
+}
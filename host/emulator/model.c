@@ -0,0 +1,654 @@
+// model.c
+// Behavioural model of the PIC18F46Q71 peripherals used by the x2-timer.
+// Everything advances together in 125ns ticks, which is the resolution
+// of the delay timers, so edges are placed to the nearest tick.
+// The model is idealized: comparators switch without propagation delay
+// or hysteresis, and the timer synchronizers add no latency.
+//
+// 2026-10-18 First cut.
+//            Reset flags and Timer0.
+//            CCP capture from pins; Timer1 from FOSC.
+//            Timer3, PWM1 and the CLC D flip-flop; pulse trains reported.
+//            Noise on the inputs; Timer1 and Timer3 clocked by the comparators.
+//            Op-amps as non-inverting amplifiers on INa and INb.
+//            Timer2 from MFINTOSC for the uptime count.
+//            VDD as the ADC reference; FVR buffer and temperature channels.
+//            TU16A and TU16B prescalers, so that they may count FOSC.
+
+#include <xc.h>
+#include "model.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TICK_NS 125u
+
+static uint64_t now_ns = 0;
+static FILE* report_file = NULL;
+
+uint64_t emu_now_ns(void) { return now_ns; }
+
+// Analog inputs and the event script --------------------------------------
+
+typedef struct {
+    uint64_t t_ns; // after arming
+    uint8_t input; // 0=INa, 1=INb
+    int mV;
+} script_step_t;
+
+static script_step_t* script = NULL;
+static size_t nscript = 0;
+static size_t script_i = 0;
+static int idle_mV[2] = {0, 0};
+static int input_mV[2] = {0, 0};
+static int noise_mV[2] = {0, 0}; // peak
+static uint32_t noise_ticks[2] = {8, 8}; // per sample
+static int noise_now_mV[2] = {0, 0};
+static uint32_t noise_seed = 12345;
+static int vdd_mV = 5000;
+static int temp_C = 25;
+
+static int compare_steps(const void* a, const void* b)
+{
+    const script_step_t* sa = a;
+    const script_step_t* sb = b;
+    return (sa->t_ns > sb->t_ns) - (sa->t_ns < sb->t_ns);
+}
+
+int emu_load_script(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) { perror(path); return 1; }
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char when[32], name[8];
+        int mV;
+        double us = 1.0;
+        int n = sscanf(line, "%31s %7s %d %lf", when, name, &mV, &us);
+        if (n <= 0) continue;
+        if (n == 2 && strcmp(when, "vdd") == 0) { vdd_mV = atoi(name); continue; }
+        if (n == 2 && strcmp(when, "temp") == 0) { temp_C = atoi(name); continue; }
+        int input = (strcmp(name, "ina") == 0) ? 0 : (strcmp(name, "inb") == 0) ? 1 : -1;
+        if (strcmp(when, "noise") == 0 && n >= 3 && input >= 0 && us >= 0.125) {
+            noise_mV[input] = mV;
+            noise_ticks[input] = (uint32_t)(us * 8.0 + 0.5);
+            continue;
+        }
+        if (n != 3 || input < 0) {
+            fprintf(stderr, "%s:%d: expected '<t_us|idle|noise> <ina|inb> <mV>', 'vdd <mV>' or 'temp <C>'\n", path, lineno);
+            fclose(f);
+            return 1;
+        }
+        if (strcmp(when, "idle") == 0) {
+            idle_mV[input] = mV;
+            input_mV[input] = mV;
+            continue;
+        }
+        char* end;
+        double t_us = strtod(when, &end);
+        if (*end != '\0' || t_us < 0.0) {
+            fprintf(stderr, "%s:%d: bad time '%s'\n", path, lineno, when);
+            fclose(f);
+            return 1;
+        }
+        script = realloc(script, (nscript + 1) * sizeof(script_step_t));
+        script[nscript].t_ns = (uint64_t)(t_us * 1000.0 + 0.5);
+        script[nscript].input = (uint8_t)input;
+        script[nscript].mV = mV;
+        nscript++;
+    }
+    fclose(f);
+    qsort(script, nscript, sizeof(script_step_t), compare_steps);
+    return 0;
+}
+
+// Shot record, reported when the firmware disarms -------------------------
+
+static uint8_t armed = 0;
+static uint64_t arm_ns = 0;
+static uint64_t event_ns[2]; // first rise of CMP1, CMP2 after arming
+static uint64_t out_ns[8]; // first rise of OUTna after arming
+static uint64_t out_fall_ns[8]; // the fall after that
+static uint64_t out_rise2_ns[8]; // and the second rise, for pulse trains
+static unsigned out_rises[8];
+static uint8_t out_last[8];
+static unsigned shot_count = 0;
+#define NEVER UINT64_MAX
+
+static void report_us(const char* label, uint64_t t, uint64_t ref)
+{
+    if (t == NEVER) {
+        fprintf(report_file, " %s -", label);
+    } else {
+        int64_t dt = (int64_t)(t - ref);
+        fprintf(report_file, " %s %+.3f", label, (double)dt / 1000.0);
+    }
+}
+
+static void report_shot(void)
+{
+    shot_count++;
+    if (event_ns[0] == NEVER) {
+        fprintf(report_file, "emu: shot %u: no Event1 while armed for %.3f us\n",
+                shot_count, (double)(now_ns - arm_ns) / 1000.0);
+        return;
+    }
+    fprintf(report_file, "emu: shot %u: Event1 %.3f us after arming;",
+            shot_count, (double)(event_ns[0] - arm_ns) / 1000.0);
+    report_us("Event2", event_ns[1], event_ns[0]);
+    fprintf(report_file, "\nemu:   us after Event1:");
+    for (int k = 0; k < 8; k++) {
+        char label[8];
+        snprintf(label, sizeof(label), "OUT%d", k);
+        report_us(label, out_ns[k], event_ns[0]);
+    }
+    for (int k = 0; k < 8; k++) {
+        if (out_rises[k] < 2) continue;
+        fprintf(report_file, "\nemu:   OUT%d %u pulses, width %.3f us, period %.3f us",
+                k, out_rises[k], (double)(out_fall_ns[k] - out_ns[k]) / 1000.0,
+                (double)(out_rise2_ns[k] - out_ns[k]) / 1000.0);
+    }
+    fprintf(report_file, "\n");
+    fflush(report_file);
+}
+
+// Peripheral state that is not visible as SFRs ----------------------------
+
+static uint8_t cmp_out[2];
+static uint8_t clc_q[8];
+static uint8_t clc_clk_last[8];
+static uint8_t ccp_out[2];
+static uint8_t cts_last[2];
+static uint8_t t1_acc = 0; // FOSC cycles not yet counted by Timer1
+static uint8_t t1_gate_last = 0; // the gate is synchronized to the timer clock
+static uint8_t t1_clk_last = 0;
+static uint8_t t3_clk_last = 0;
+static uint16_t t0_acc = 0;
+static uint32_t t2_acc = 0;
+static uint8_t t3_acc = 0;
+static uint8_t t3_gate_last = 0;
+static uint8_t t3_out = 0; // overflow pulse, one tick long
+static uint16_t pwm_acc = 0;
+static uint16_t pwm_count = 0;
+static uint8_t pwm_out = 0;
+
+typedef struct {
+    uint16_t count;
+    uint16_t acc; // FOSC cycles towards the next count
+    uint8_t running;
+    uint8_t ers_last;
+    uint8_t out;
+} tu16_t;
+static tu16_t tuA, tuB;
+
+static uint16_t fvr_mV(uint8_t code)
+{
+    // FVR gain selections 1x, 2x, 4x of 1.024V.
+    static const uint16_t mV[4] = {0, 1024, 2048, 4096};
+    return FVRCONbits.EN ? mV[code & 3] : 0;
+}
+
+static int dac_mV(uint8_t n)
+{
+    uint8_t en = (n == 2) ? DAC2CONbits.EN : DAC3CONbits.EN;
+    uint8_t data = (n == 2) ? DAC2DATL : DAC3DATL;
+    if (!en) return 0;
+    return (int)((uint32_t)data * fvr_mV(FVRCONbits.CDAFVR) / 256u);
+}
+
+static int opa_mV(uint8_t n)
+{
+    // Non-inverting, from the input pin through the resistor ladder,
+    // with the output limited to the 5V rails.
+    static const int num[8] = {16, 8, 4, 2, 8, 4, 8, 16};
+    static const int den[8] = {15, 7, 3, 1, 3, 1, 1, 1};
+    uint8_t en = (n == 1) ? OPA1CON0bits.EN : OPA2CON0bits.EN;
+    uint8_t gsel = ((n == 1) ? OPA1CON1bits.GSEL : OPA2CON1bits.GSEL) & 7;
+    if (!en) return 0;
+    int k = n - 1;
+    int mV = (input_mV[k] + noise_now_mV[k]) * num[gsel] / den[gsel];
+    return (mV < 0) ? 0 : (mV > 5000) ? 5000 : mV;
+}
+
+static int channel_mV(uint8_t nch_or_pch, uint8_t negative)
+{
+    if (negative) {
+        if (nch_or_pch == 0b000) return input_mV[0] + noise_now_mV[0]; // INa on RA0
+        if (nch_or_pch == 0b011) return input_mV[1] + noise_now_mV[1]; // INb on RB1
+        if (nch_or_pch == 0b110) return opa_mV(1);
+        if (nch_or_pch == 0b111) return opa_mV(2);
+    } else {
+        if (nch_or_pch == 0b100) return dac_mV(2);
+        if (nch_or_pch == 0b101) return dac_mV(3);
+    }
+    return 0;
+}
+
+static void update_noise(void)
+{
+    uint64_t tick = now_ns / TICK_NS;
+    for (int k = 0; k < 2; k++) {
+        if (noise_mV[k] == 0 || tick % noise_ticks[k] != 0) continue;
+        noise_seed = noise_seed * 1103515245u + 12345u;
+        int span = 2 * noise_mV[k] + 1;
+        noise_now_mV[k] = (int)((noise_seed >> 8) % (uint32_t)span) - noise_mV[k];
+    }
+}
+
+static void update_comparators(void)
+{
+    if (CM1CON0bits.EN) {
+        int vp = channel_mV(CM1PCH, 0), vn = channel_mV(CM1NCH, 1);
+        cmp_out[0] = (uint8_t)((vp > vn) ^ (CM1CON0bits.POL & 1));
+    } else {
+        cmp_out[0] = 0;
+    }
+    if (CM2CON0bits.EN) {
+        int vp = channel_mV(CM2PCH, 0), vn = channel_mV(CM2NCH, 1);
+        cmp_out[1] = (uint8_t)((vp > vn) ^ (CM2CON0bits.POL & 1));
+    } else {
+        cmp_out[1] = 0;
+    }
+    CMOUTbits.MC1OUT = cmp_out[0];
+    CMOUTbits.MC2OUT = cmp_out[1];
+}
+
+static uint8_t clc_source(uint8_t sel)
+{
+    // CLC input selections, Table 24-2 in the data sheet.
+    switch (sel) {
+    case 0x10: return t3_out;
+    case 0x17: return ccp_out[0];
+    case 0x18: return ccp_out[1];
+    case 0x20: return cmp_out[0];
+    case 0x21: return cmp_out[1];
+    case 0x36: return tuA.out;
+    case 0x37: return tuB.out;
+    default: return 0;
+    }
+}
+
+static void update_clcs(void)
+{
+    for (int n = 0; n < 8; n++) {
+        volatile emu_clc_t* c = &emu_clc[n];
+        if (!c->con.EN) { clc_q[n] = 0; clc_clk_last[n] = 1; continue; }
+        uint8_t data[4];
+        for (int d = 0; d < 4; d++) data[d] = clc_source(c->sel[d]);
+        uint8_t gpol[4] = {c->pol.G1POL, c->pol.G2POL, c->pol.G3POL, c->pol.G4POL};
+        uint8_t gate[4];
+        for (int g = 0; g < 4; g++) {
+            uint8_t v = 0;
+            for (int d = 0; d < 4; d++) {
+                if (c->gls[g] & (2u << (2*d))) v |= data[d];
+                if (c->gls[g] & (1u << (2*d))) v |= !data[d];
+            }
+            gate[g] = v ^ (gpol[g] & 1);
+        }
+        // Only the S-R latch and the D flip-flop are used by the firmware;
+        // reset dominates in both.
+        if (c->con.MODE == 0b011) {
+            if (gate[2] | gate[3]) clc_q[n] = 0;
+            else if (gate[0] | gate[1]) clc_q[n] = 1;
+        } else if (c->con.MODE == 0b100) {
+            // Clock gate 1, D gate 2, R gate 3, S gate 4.
+            uint8_t rising = gate[0] && !clc_clk_last[n];
+            clc_clk_last[n] = gate[0];
+            if (gate[2]) clc_q[n] = 0;
+            else if (gate[3]) clc_q[n] = 1;
+            else if (rising) clc_q[n] = gate[1];
+        }
+    }
+    uint8_t q[8];
+    for (int n = 0; n < 8; n++) q[n] = clc_q[n] ^ (emu_clc[n].pol.POL & 1);
+    CLCDATAbits.CLC1OUT = q[0]; CLCDATAbits.CLC2OUT = q[1];
+    CLCDATAbits.CLC3OUT = q[2]; CLCDATAbits.CLC4OUT = q[3];
+    CLCDATAbits.CLC5OUT = q[4]; CLCDATAbits.CLC6OUT = q[5];
+    CLCDATAbits.CLC7OUT = q[6]; CLCDATAbits.CLC8OUT = q[7];
+}
+
+static uint8_t clc_level(int code, int first_code)
+{
+    // CLCn_OUT selections are consecutive codes in the various tables.
+    int n = code - first_code;
+    if (n < 0 || n > 7) return 0;
+    return clc_q[n] ^ (emu_clc[n].pol.POL & 1);
+}
+
+static void step_tu16(tu16_t* t, volatile TU16CON0bits_t* con0,
+                      volatile TU16CON1bits_t* con1, volatile TU16HLTbits_t* hlt,
+                      uint8_t ers, uint8_t ps, uint16_t pr)
+{
+    // Pulse output at PR match, a one-tick pulse PR+1 counts after the start,
+    // counting FOSC through the prescaler, 8 FOSC cycles per tick.
+    // CSYNC is taken as set; the start is at a tick, whatever it is.
+    t->out = 0;
+    uint8_t level = clc_level(ers, 0b01110); // CLC1_OUT is 0b01110
+    uint8_t rising = level && !t->ers_last;
+    t->ers_last = level;
+    if (con1->CLR) { t->count = 0; con1->CLR = 0; }
+    if (!con0->ON) { t->running = 0; con1->RUN = 0; return; }
+    if (t->running) {
+        uint16_t period = (uint16_t)ps + 1;
+        t->acc += 8;
+        while (t->running && t->acc >= period) {
+            t->acc -= period;
+            if (t->count == pr) {
+                t->out = 1;
+                if (hlt->STOP == 0b11) { t->running = 0; }
+                t->count = 0;
+            } else {
+                t->count++;
+            }
+        }
+    } else if (hlt->START == 0b10 && rising) {
+        t->running = 1;
+        t->count = 0;
+        t->acc = 0;
+    }
+    con1->RUN = t->running;
+}
+
+static void compare_match(void)
+{
+    if (CCP1CONbits.EN && CCP1CONbits.MODE == 0b1000 && TMR1 == CCPR1) {
+        ccp_out[0] = 1; PIR3bits.CCP1IF = 1;
+    }
+    if (CCP2CONbits.EN && CCP2CONbits.MODE == 0b1000 && TMR1 == CCPR2) {
+        ccp_out[1] = 1; PIR8bits.CCP2IF = 1;
+    }
+}
+
+static uint8_t input_pin(uint8_t pps)
+{
+    // Input PPS codes are port*8 + pin, with port A=0.
+    switch (pps) {
+    case 0x0A: return PORTBbits.RB2;
+    case 0x0B: return PORTBbits.RB3;
+    case 0x0C: return PORTBbits.RB4;
+    case 0x0D: return PORTBbits.RB5;
+    case 0x12: return PORTCbits.RC2;
+    case 0x13: return PORTCbits.RC3;
+    case 0x14: return PORTCbits.RC4;
+    case 0x15: return PORTCbits.RC5;
+    default: return 0;
+    }
+}
+
+static uint8_t capture_source(uint8_t cts, uint8_t pps)
+{
+    if (cts == 0b0000) return input_pin(pps);
+    if (cts == 0b0010) return cmp_out[0];
+    if (cts == 0b0011) return cmp_out[1];
+    return clc_level(cts, 0b0100); // CLC1_OUT is 0b0100
+}
+
+static uint8_t comparator_clock(uint8_t cs, uint8_t* last)
+{
+    // Rising edges of CMP1_OUT (0b01100) or CMP2_OUT (0b01101)
+    // as a timer clock, the prescaler being 1:1.
+    uint8_t level = (cs == 0b01100) ? cmp_out[0] : (cs == 0b01101) ? cmp_out[1] : 0;
+    uint8_t rising = level && !*last;
+    *last = level;
+    return rising;
+}
+
+static void step_timer1(void)
+{
+    if (!CCP1CONbits.EN) ccp_out[0] = 0;
+    if (!CCP2CONbits.EN) ccp_out[1] = 0;
+    uint8_t counting = T1CONbits.ON;
+    uint8_t gate = clc_level(T1GATEbits.GSS, 0b10010); // CLC1_OUT is 0b10010
+    if (counting && T1GCONbits.GE) {
+        counting = (t1_gate_last == (T1GCONbits.GPOL & 1));
+    }
+    t1_gate_last = gate;
+    uint8_t edges = comparator_clock(T1CLKbits.CS, &t1_clk_last);
+    if (counting && T1CLKbits.CS >= 0b01100) {
+        if (edges) {
+            TMR1++;
+            if (TMR1 == 0) PIR3bits.TMR1IF = 1;
+            compare_match();
+        }
+    } else if (counting) {
+        // Clocked from FOSC/4 or FOSC, with 8 FOSC cycles per tick.
+        uint8_t period = (uint8_t)(((T1CLKbits.CS == 0b00010) ? 1u : 4u) << (T1CONbits.CKPS & 3));
+        t1_acc += 8;
+        while (t1_acc >= period) {
+            t1_acc -= period;
+            TMR1++;
+            if (TMR1 == 0) PIR3bits.TMR1IF = 1;
+            compare_match();
+        }
+    }
+    // Capture on rising edges of the selected source.
+    uint8_t cts = capture_source(CCP1CAPbits.CTS, CCP1PPS);
+    if (CCP1CONbits.EN && CCP1CONbits.MODE == 0b0101 && cts && !cts_last[0]) {
+        CCPR1 = TMR1;
+        PIR3bits.CCP1IF = 1;
+    }
+    cts_last[0] = cts;
+    cts = capture_source(CCP2CAPbits.CTS, CCP2PPS);
+    if (CCP2CONbits.EN && CCP2CONbits.MODE == 0b0101 && cts && !cts_last[1]) {
+        CCPR2 = TMR1;
+        PIR8bits.CCP2IF = 1;
+    }
+    cts_last[1] = cts;
+    CCP1CONbits.OUT = ccp_out[0];
+    CCP2CONbits.OUT = ccp_out[1];
+}
+
+static void step_timer3(void)
+{
+    // Gated like Timer1, without CCPs; the overflow is a one-tick pulse.
+    t3_out = 0;
+    uint8_t counting = T3CONbits.ON;
+    uint8_t gate = clc_level(T3GATEbits.GSS, 0b10010); // CLC1_OUT is 0b10010
+    if (counting && T3GCONbits.GE) {
+        counting = (t3_gate_last == (T3GCONbits.GPOL & 1));
+    }
+    t3_gate_last = gate;
+    uint8_t edges = comparator_clock(T3CLKbits.CS, &t3_clk_last);
+    if (!counting) return;
+    if (T3CLKbits.CS >= 0b01100) {
+        if (edges && ++TMR3 == 0) t3_out = 1;
+        return;
+    }
+    uint8_t period = (uint8_t)(((T3CLKbits.CS == 0b00010) ? 1u : 4u) << (T3CONbits.CKPS & 3));
+    t3_acc += 8;
+    while (t3_acc >= period) {
+        t3_acc -= period;
+        TMR3++;
+        if (TMR3 == 0) t3_out = 1;
+    }
+}
+
+static void step_pwm1(void)
+{
+    // Slice 1, left aligned, from FOSC through the prescaler.
+    // The external reset holds the counter at zero and the output inactive.
+    if (!PWM1CONbits.EN) { pwm_out = 0; pwm_count = 0; pwm_acc = 0; return; }
+    uint8_t level = clc_level(PWM1ERS, 0b01110); // CLC1_OUT is 0b01110
+    if (level != (PWM1CONbits.ERSPOL & 1)) {
+        pwm_count = 0;
+        pwm_acc = 0;
+        pwm_out = PWM1S1CFGbits.POL1 & 1;
+        return;
+    }
+    pwm_out = (uint8_t)((pwm_count < PWM1S1P1) ^ (PWM1S1CFGbits.POL1 & 1));
+    pwm_acc += 8;
+    while (pwm_acc >= (uint16_t)PWM1CPRE + 1) {
+        pwm_acc -= (uint16_t)PWM1CPRE + 1;
+        pwm_count = (pwm_count >= PWM1PR) ? 0 : pwm_count + 1;
+    }
+}
+
+static void step_timer0(void)
+{
+    // 16-bit mode from FOSC/4 only, as used for the boot timer.
+    if (!T0CON0bits.EN || !T0CON0bits.MD16) return;
+    uint16_t period = (uint16_t)(1u << (T0CON1bits.CKPS & 0x0f));
+    t0_acc += 2;
+    if (t0_acc >= period) {
+        t0_acc -= period;
+        uint16_t count = (uint16_t)((TMR0H << 8) | TMR0L) + 1;
+        TMR0H = (uint8_t)(count >> 8);
+        TMR0L = (uint8_t)count;
+    }
+}
+
+static void step_timer2(void)
+{
+    // MFINTOSC at 31.25kHz is 256 ticks per cycle, before the prescaler.
+    if (!T2CONbits.ON || T2CLKCONbits.CS != 0b0110) return;
+    if (++t2_acc < (256u << (T2CONbits.CKPS & 7))) return;
+    t2_acc = 0;
+    T2TMR = (uint8_t)((T2TMR >= T2PR) ? 0 : T2TMR + 1);
+}
+
+static void step_adc(void)
+{
+    if (!ADCON0bits.GO) return;
+    if (ADCON0bits.ON) {
+        int mV;
+        switch (ADPCH) {
+        case 0: mV = input_mV[0] + noise_now_mV[0]; break;
+        case 9: mV = input_mV[1] + noise_now_mV[1]; break;
+        case 57: mV = dac_mV(2); break;
+        case 58: mV = dac_mV(3); break;
+        case 59: mV = opa_mV(1); break;
+        case 60: mV = opa_mV(2); break;
+        case 61: // temperature indicator, falling with temperature
+            mV = FVRCONbits.TSEN ? EMU_DIA_TSLR2 / 2
+                 + (90 - temp_C) * EMU_TEMP_GAIN_UV_PER_C / 1000 : 0;
+            break;
+        case 62: mV = fvr_mV(FVRCONbits.ADFVR); break;
+        default: mV = 0;
+        }
+        uint16_t vref = (ADREFbits.PREF == 0b00) ? (uint16_t)vdd_mV : fvr_mV(FVRCONbits.ADFVR);
+        long counts = (vref == 0 || mV < 0) ? 0 : (long)mV * 4096 / vref;
+        ADRES = (uint16_t)(counts > 4095 ? 4095 : counts);
+        PIR1bits.ADIF = 1;
+    }
+    ADCON0bits.GO = 0;
+}
+
+// Output pins, in the order OUT0a, OUT0b, OUT1a, ... OUT7b.
+#define NPINS 16
+static volatile uint8_t* const pin_pps[NPINS] = {
+    &RC2PPS, &RC3PPS, &RD0PPS, &RD1PPS, &RD2PPS, &RD3PPS, &RC4PPS, &RC5PPS,
+    &RD4PPS, &RD5PPS, &RD6PPS, &RD7PPS, &RB2PPS, &RB3PPS, &RB4PPS, &RB5PPS
+};
+static volatile uint8_t* const pin_lat[NPINS] = {
+    &LATCbits.LATC2, &LATCbits.LATC3, &LATDbits.LATD0, &LATDbits.LATD1,
+    &LATDbits.LATD2, &LATDbits.LATD3, &LATCbits.LATC4, &LATCbits.LATC5,
+    &LATDbits.LATD4, &LATDbits.LATD5, &LATDbits.LATD6, &LATDbits.LATD7,
+    &LATBbits.LATB2, &LATBbits.LATB3, &LATBbits.LATB4, &LATBbits.LATB5
+};
+static volatile uint8_t* const pin_port[NPINS] = {
+    &PORTCbits.RC2, &PORTCbits.RC3, &PORTDbits.RD0, &PORTDbits.RD1,
+    &PORTDbits.RD2, &PORTDbits.RD3, &PORTCbits.RC4, &PORTCbits.RC5,
+    &PORTDbits.RD4, &PORTDbits.RD5, &PORTDbits.RD6, &PORTDbits.RD7,
+    &PORTBbits.RB2, &PORTBbits.RB3, &PORTBbits.RB4, &PORTBbits.RB5
+};
+
+static uint8_t pps_level(uint8_t code, uint8_t lat)
+{
+    // Output source selections, Table 23-2 in the data sheet.
+    if (code == 0x00) return lat;
+    if (code >= 0x01 && code <= 0x08) return clc_level(code, 0x01);
+    if (code == 0x0D) return ccp_out[0];
+    if (code == 0x0E) return ccp_out[1];
+    if (code == 0x0F) return pwm_out;
+    return 0;
+}
+
+static void update_pins(void)
+{
+    for (int i = 0; i < NPINS; i++) {
+        uint8_t level = pps_level(*pin_pps[i], *pin_lat[i] & 1);
+        *pin_port[i] = level;
+        if (!armed || (i % 2) != 0) continue;
+        int k = i / 2;
+        if (level && !out_last[k]) {
+            if (out_rises[k] == 0) out_ns[k] = now_ns;
+            if (out_rises[k] == 1) out_rise2_ns[k] = now_ns;
+            out_rises[k]++;
+        }
+        if (!level && out_last[k] && out_fall_ns[k] == NEVER) out_fall_ns[k] = now_ns;
+        out_last[k] = level;
+    }
+}
+
+static void watch_arming(void)
+{
+    // LED1 is lit for as long as the firmware is armed.
+    uint8_t led1 = LATEbits.LATE1 & 1;
+    if (led1 && !armed) {
+        armed = 1;
+        arm_ns = now_ns;
+        script_i = 0;
+        event_ns[0] = event_ns[1] = NEVER;
+        for (int k = 0; k < 8; k++) {
+            out_ns[k] = out_fall_ns[k] = out_rise2_ns[k] = NEVER;
+            out_rises[k] = 0;
+            out_last[k] = 0;
+        }
+    } else if (!led1 && armed) {
+        armed = 0;
+        report_shot();
+        input_mV[0] = idle_mV[0];
+        input_mV[1] = idle_mV[1];
+    }
+    if (!armed) return;
+    while (script_i < nscript && now_ns - arm_ns >= script[script_i].t_ns) {
+        input_mV[script[script_i].input] = script[script_i].mV;
+        script_i++;
+    }
+}
+
+void emu_tick(void)
+{
+    now_ns += TICK_NS;
+    watch_arming();
+    update_noise();
+    update_comparators();
+    if (armed) {
+        if (cmp_out[0] && event_ns[0] == NEVER) event_ns[0] = now_ns;
+        if (cmp_out[1] && event_ns[1] == NEVER) event_ns[1] = now_ns;
+    }
+    // Timer outputs feed latches, and latches start timers,
+    // within the same tick.
+    update_clcs();
+    step_timer1();
+    update_clcs();
+    step_tu16(&tuA, &TU16ACON0bits, &TU16ACON1bits, &TU16AHLTbits, TU16AERS, TU16APS, TU16APR);
+    step_tu16(&tuB, &TU16BCON0bits, &TU16BCON1bits, &TU16BHLTbits, TU16BERS, TU16BPS, TU16BPR);
+    update_clcs();
+    step_timer3();
+    update_clcs();
+    step_pwm1();
+    update_pins();
+    step_timer0();
+    step_timer2();
+    step_adc();
+}
+
+void emu_delay_ticks(uint64_t n)
+{
+    while (n--) emu_tick();
+}
+
+void emu_init(FILE* report)
+{
+    report_file = report;
+    FVRCONbits.RDY = 1; // the reference settles instantly
+    // Coming out of a power-on reset.
+    PCON0bits.RWDT = 1; PCON0bits.WDTWV = 1; PCON0bits.RMCLR = 1; PCON0bits.RI = 1;
+    PCON1bits.MEMV = 1;
+    input_mV[0] = idle_mV[0];
+    input_mV[1] = idle_mV[1];
+}
@@ -0,0 +1,47 @@
+// model.h
+// Behavioural model of the PIC18F46Q71 peripherals used by the x2-timer,
+// stepped in 125ns ticks, together with the analog event injector.
+//
+// 2026-10-18 First cut.
+//            Noise on the inputs.
+//            Storage Area Flash.
+//            Supply voltage and die temperature.
+
+#ifndef EMU_MODEL_H
+#define EMU_MODEL_H
+#include <stdint.h>
+#include <stdio.h>
+
+// Read the event script; returns 0 on success.
+// Script lines, with # starting a comment:
+//   idle <ina|inb> <mV>        input level while not armed
+//   <t_us> <ina|inb> <mV>      step the input at t_us after arming
+//   noise <ina|inb> <mV> [<us>]  add uniform noise of +/- mV,
+//                              a new sample every us (default 1)
+//   vdd <mV>                   supply voltage (default 5000)
+//   temp <C>                   die temperature (default 25)
+int emu_load_script(const char* path);
+
+void emu_init(FILE* report);
+
+// Simulated time since start, in nanoseconds.
+uint64_t emu_now_ns(void);
+
+// Data EEPROM image, initialized from the __EEPROM_DATA lines.
+#define EMU_EEPROM_SIZE 1024
+extern uint8_t emu_eeprom[EMU_EEPROM_SIZE];
+int emu_eeprom_load(const char* path);
+void emu_eeprom_store(void);
+
+// Storage Area Flash image, erased unless loaded from a file.
+int emu_saf_load(const char* path);
+
+// Calibration words as the Device Information Area holds them.
+#define EMU_DIA_FVRA1X 1024 // mV, the modelled FVR is exact
+#define EMU_DIA_TSLR2 1500  // counts of 0.5mV: 750mV at 90C
+#define EMU_TEMP_GAIN_UV_PER_C 3684
+
+// The pty that stands in for UART1.
+void emu_uart_attach(int fd);
+
+#endif
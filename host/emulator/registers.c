@@ -0,0 +1,7 @@
+// registers.c
+// Storage for the modelled register file declared in xc.h.
+//
+// 2026-10-18 First cut.
+
+#define EMU_DEFINE_REGISTERS
+#include "xc.h"
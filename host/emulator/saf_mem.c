@@ -0,0 +1,90 @@
+// saf_mem.c
+// Storage Area Flash for the emulator, in place of saf.c.
+// Writes can only clear bits and erasing sets a page to all ones,
+// as with the real flash, so torn writes behave much the same.
+// If a backing file is given, it is rewritten after every change.
+//
+// 2026-10-18 First cut.
+//            Device Information Area.
+//            Row writes.
+
+#include <xc.h>
+#include "saf.h"
+#include "model.h"
+#include <stdio.h>
+#include <string.h>
+
+uint8_t emu_saf[SAF_SIZE];
+static const char* backing_path = NULL;
+
+int emu_saf_load(const char* path)
+{
+    memset(emu_saf, 0xff, sizeof(emu_saf));
+    backing_path = path;
+    if (!path) return 0;
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0; // created on the first write
+    size_t n = fread(emu_saf, 1, sizeof(emu_saf), f);
+    fclose(f);
+    return (n == sizeof(emu_saf)) ? 0 : 1;
+}
+
+static void store(void)
+{
+    if (!backing_path) return;
+    FILE* f = fopen(backing_path, "wb");
+    if (!f) { perror(backing_path); return; }
+    fwrite(emu_saf, 1, sizeof(emu_saf), f);
+    fclose(f);
+}
+
+static uint32_t offset(uint32_t addr)
+{
+    return (addr - SAF_START) % SAF_SIZE;
+}
+
+uint16_t SAF_ReadWord(uint32_t addr)
+{
+    uint32_t i = offset(addr) & ~1u;
+    return (uint16_t)(emu_saf[i] | (emu_saf[i+1] << 8));
+}
+
+void SAF_WriteWord(uint32_t addr, uint16_t data)
+{
+    // A word write stalls the CPU for about 50us.
+    emu_delay_ticks(50 * 8u);
+    uint32_t i = offset(addr) & ~1u;
+    emu_saf[i] &= (uint8_t)(data & 0xFF);
+    emu_saf[i+1] &= (uint8_t)(data >> 8);
+    store();
+}
+
+void SAF_WriteRow(uint32_t addr, const uint16_t* words, uint8_t n)
+{
+    // A row goes in one write, taking about as long as a word.
+    emu_delay_ticks(50 * 8u);
+    uint32_t i = offset(addr) & ~1u;
+    for (uint8_t k=0; k < n; ++k, i += 2) {
+        emu_saf[i] &= (uint8_t)(words[k] & 0xFF);
+        emu_saf[i+1] &= (uint8_t)(words[k] >> 8);
+    }
+    store();
+}
+
+uint16_t DIA_ReadWord(uint32_t addr)
+{
+    switch (addr) {
+    case DIA_FVRA1X: return EMU_DIA_FVRA1X;
+    case DIA_TSLR2: return EMU_DIA_TSLR2;
+    default: return 0xFFFF;
+    }
+}
+
+void SAF_ErasePage(uint32_t addr)
+{
+    // A page erase takes about 10ms.
+    emu_delay_ticks(10 * 8000u);
+    uint32_t i = offset(addr) & ~(uint32_t)(SAF_PAGE_SIZE - 1);
+    memset(&emu_saf[i], 0xff, SAF_PAGE_SIZE);
+    store();
+}
@@ -0,0 +1,278 @@
+// uart_pty.c
+// The uart.h interface on a pseudo-terminal, in place of uart.c,
+// for the firmware running in the emulator.
+// Command lines are assembled and queued just as uart.c does it.
+// While the firmware polls for input with nothing pending,
+// we wait briefly in real time so that an idle emulator sleeps
+// and simulated time keeps roughly in step with the wall clock.
+//
+// 2026-10-18 First cut.
+//            Probe on getstr(), as in uart.c.
+//            Wait hook, as in uart.c.
+//            Read no more than the ring has room for.
+
+#define _DEFAULT_SOURCE
+#include <xc.h>
+#include "uart.h"
+#include "model.h"
+#include "profile.h"
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NRXRING 4096
+static char rxring[NRXRING];
+static uint16_t rx_head = 0;
+static uint16_t rx_tail = 0;
+
+#define NRXLINES 8
+#define NRXLINE 80
+static char rxlines[NRXLINES][NRXLINE];
+static uint8_t rxline_len[NRXLINES];
+static uint8_t rxline_head = 0;
+static uint8_t rxline_tail = 0;
+static uint8_t rxline_count = 0;
+static uint8_t rxline_i = 0;
+static uint8_t rxline_truncated = 0;
+// A pty has no framing errors or FIFO overflows, only long lines.
+// Nor does the ring overrun: what it has no room for waits in the pty.
+static uint16_t rx_truncated_lines = 0;
+
+#define NTXBUF 1024
+static char txbuf[NTXBUF];
+static uint16_t tx_n = 0;
+static uint8_t tx_muted = 0;
+
+static int pty_fd = -1;
+
+// Simulated time stands still in the waits, but the firmware's hook
+// is called all the same.
+static void (*wait_hook)(void) = 0;
+
+void uart1_set_wait_hook(void (*hook)(void))
+{
+    wait_hook = hook;
+}
+
+static void wait_step(void)
+{
+    if (wait_hook) wait_hook();
+    CLRWDT();
+}
+
+void emu_uart_attach(int fd)
+{
+    pty_fd = fd;
+}
+
+static void pty_write_all(void)
+{
+    uint16_t done = 0;
+    while (done < tx_n) {
+        ssize_t n = write(pty_fd, txbuf + done, tx_n - done);
+        if (n > 0) { done += (uint16_t)n; continue; }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) break;
+        // Nobody is draining the pty; wait a little, then give up.
+        struct pollfd p = {pty_fd, POLLOUT, 0};
+        if (poll(&p, 1, 100) <= 0) break;
+    }
+    tx_n = 0;
+}
+
+static void pty_read(int timeout_ms)
+{
+    struct pollfd p = {pty_fd, POLLIN, 0};
+    if (poll(&p, 1, timeout_ms) <= 0 || !(p.revents & POLLIN)) return;
+    char buf[256];
+    size_t room = (size_t)((rx_tail + NRXRING - rx_head - 1) % NRXRING);
+    if (room > sizeof(buf)) room = sizeof(buf);
+    if (room == 0) return;
+    ssize_t n = read(pty_fd, buf, room);
+    for (ssize_t i = 0; i < n; i++) {
+        rxring[rx_head] = buf[i];
+        rx_head = (rx_head + 1) % NRXRING;
+    }
+}
+
+void uart1_init(long baud)
+{
+    (void)baud;
+    rx_head = rx_tail = 0;
+    uart1_flush_rx();
+}
+
+void uart1_set_baud(long baud)
+{
+    // The pty carries bytes at whatever rate the host asks for.
+    uart1_tx_flush();
+    (void)baud;
+}
+
+void uart1_tx_service(void)
+{
+    if (tx_n) pty_write_all();
+}
+
+void uart1_tx_flush(void)
+{
+    uart1_tx_service();
+}
+
+void uart1_mute(uint8_t muted)
+{
+    tx_muted = muted;
+}
+
+void uart1_putch(char data)
+{
+    if (tx_muted) return;
+    txbuf[tx_n++] = data;
+    if (tx_n == NTXBUF || data == '\n') pty_write_all();
+}
+
+void uart1_putrom(const char* str, uint16_t n)
+{
+    while (n--) uart1_putch(*str++);
+}
+
+void uart1_flush_rx(void)
+{
+    pty_read(0);
+    rx_tail = rx_head;
+    rxline_head = 0;
+    rxline_tail = 0;
+    rxline_count = 0;
+    rxline_i = 0;
+    rxline_truncated = 0;
+}
+
+void uart1_wait_rx_idle(void)
+{
+    // Bytes arrive whole on the pty.
+}
+
+uint8_t uart1_rx_available(void)
+{
+    uart1_tx_service();
+    if (rx_tail == rx_head) pty_read(1);
+    return rx_tail != rx_head;
+}
+
+char uart1_getch(void)
+{
+    while (!uart1_rx_available()) { wait_step(); }
+    char c = rxring[rx_tail];
+    rx_tail = (rx_tail + 1) % NRXRING;
+    return c;
+}
+
+uint16_t uart1_rx_check(void)
+{
+    pty_read(0);
+    return rx_head;
+}
+
+void uart1_rx_service(void)
+// Without waiting, as it is also called in the armed wait loops,
+// where each pass is a tick of simulated time.
+{
+    pty_read(0);
+    while (rx_tail != rx_head && rxline_count < NRXLINES) {
+        char c = rxring[rx_tail];
+        rx_tail = (rx_tail + 1) % NRXRING;
+        if (c != '\n' && c != '\r' && c != '\b') {
+            if (rxline_i < (NRXLINE-1)) {
+                rxlines[rxline_head][rxline_i] = c;
+                rxline_i++;
+            } else if (!rxline_truncated) {
+                rxline_truncated = 1;
+                if (rx_truncated_lines < 0xFFFF) rx_truncated_lines++;
+            }
+        }
+        if (c == '\r') {
+            rxlines[rxline_head][rxline_i] = '\0';
+            rxline_len[rxline_head] = rxline_i;
+            rxline_head = (rxline_head + 1) % NRXLINES;
+            rxline_count++;
+            rxline_i = 0;
+            rxline_truncated = 0;
+        }
+        if (c == '\b' && rxline_i > 0) {
+            rxline_i--;
+        }
+    }
+    uart1_tx_service();
+}
+
+uint8_t uart1_line_ready(void)
+// The main loop polls here; with nothing pending, wait a little.
+{
+    if (rx_tail == rx_head && rxline_count == 0) pty_read(1);
+    uart1_rx_service();
+    return rxline_count > 0;
+}
+
+const char* uart1_peek_line(void)
+{
+    if (!uart1_line_ready()) return 0;
+    return rxlines[rxline_tail];
+}
+
+void uart1_drop_line(void)
+{
+    if (rxline_count == 0) return;
+    rxline_tail = (rxline_tail + 1) % NRXLINES;
+    rxline_count--;
+}
+
+void uart1_error_counts(uint16_t* framing, uint16_t* overflow, uint16_t* truncated,
+                        uint16_t* overrun)
+{
+    *framing = 0;
+    *overflow = 0;
+    *truncated = rx_truncated_lines;
+    *overrun = 0;
+}
+
+void uart1_close(void)
+{
+    uart1_tx_flush();
+}
+
+void putch(char data)
+{
+    uart1_putch(data);
+}
+
+int getch(void)
+{
+    return uart1_getch();
+}
+
+int getche(void)
+{
+    int data = getch();
+    putch((char)data);
+    return data;
+}
+
+int getstr(char* buf, int nbuf)
+{
+    int i;
+    while (!uart1_line_ready()) { wait_step(); }
+    PROBE_BEGIN(PROBE_GETSTR);
+    char* line = rxlines[rxline_tail];
+    int n = rxline_len[rxline_tail];
+    for (i=0; i < n && i < (nbuf-1); i++) { buf[i] = line[i]; }
+    buf[i] = '\0';
+    rxline_tail = (rxline_tail + 1) % NRXLINES;
+    rxline_count--;
+    PROBE_END(PROBE_GETSTR);
+    return i;
+}
+
+void putstr(const char* str)
+{
+    while (*str) putch(*str++);
+}
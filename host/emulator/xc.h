@@ -0,0 +1,201 @@
+// xc.h for the x2-timer emulator
+// A modelled register file standing in for the XC8 device header,
+// so that the firmware sources compile natively on Linux.
+// Only the registers and bits used by the firmware are present.
+// Bit fields are held as whole bytes, without the SFR layout,
+// so the firmware and the model must use the same view of each register.
+//
+// NOP(), CLRWDT() and the delay macros advance simulated time,
+// which is what lets the firmware's busy-wait loops make progress.
+//
+// 2026-10-18 First cut.
+//            Reset flags and Timer0.
+//            CCP capture from pins.
+//            Timer3 and PWM1 for the pulse trains.
+//            Op-amps.
+//            Timer2 for the uptime count.
+//            Temperature indicator.
+
+#ifndef EMU_XC_H
+#define EMU_XC_H
+
+#include <stdint.h>
+
+#ifdef EMU_DEFINE_REGISTERS
+#define EMU_EXTERN
+#else
+#define EMU_EXTERN extern
+#endif
+
+#define SFR8(name) EMU_EXTERN volatile uint8_t name
+#define SFR16(name) EMU_EXTERN volatile uint16_t name
+#define SFRBITS(name, ...) \
+    typedef struct { uint8_t __VA_ARGS__; } name##bits_t; \
+    EMU_EXTERN volatile name##bits_t name##bits
+
+typedef uint32_t __uint24;
+
+// Time passes in steps of 125ns, the tick of all of the delay timers.
+void emu_tick(void);
+void emu_delay_ticks(uint64_t n);
+void emu_eeprom_data(int line, uint8_t a, uint8_t b, uint8_t c, uint8_t d,
+                     uint8_t e, uint8_t f, uint8_t g, uint8_t h);
+
+#define NOP() emu_tick()
+#define CLRWDT() emu_tick()
+#define __delay_us(x) emu_delay_ticks((uint64_t)(x) * 8u)
+#define __delay_ms(x) emu_delay_ticks((uint64_t)(x) * 8000u)
+
+// Each use registers its 8 bytes, ordered by source line.
+#define EMU_CAT2(a, b) a##b
+#define EMU_CAT(a, b) EMU_CAT2(a, b)
+#define __EEPROM_DATA(a, b, c, d, e, f, g, h) \
+    static void __attribute__((constructor)) EMU_CAT(emu_eeprom_init_, __LINE__)(void) \
+    { emu_eeprom_data(__LINE__, a, b, c, d, e, f, g, h); }
+
+// Reset flags
+SFRBITS(PCON0, STKOVF, STKUNF, WDTWV, RWDT, RMCLR, RI, POR, BOR);
+SFRBITS(PCON1, MEMV);
+
+// Interrupts and locks
+SFR8(GIE);
+SFR8(PPSLOCK);
+SFR8(PPSLOCKED);
+
+// Ports
+SFRBITS(LATB, LATB2, LATB3, LATB4, LATB5);
+SFRBITS(LATC, LATC2, LATC3, LATC4, LATC5);
+SFRBITS(LATD, LATD0, LATD1, LATD2, LATD3, LATD4, LATD5, LATD6, LATD7);
+SFRBITS(LATE, LATE0, LATE1, LATE2);
+SFRBITS(PORTB, RB2, RB3, RB4, RB5);
+SFRBITS(PORTC, RC2, RC3, RC4, RC5);
+SFRBITS(PORTD, RD0, RD1, RD2, RD3, RD4, RD5, RD6, RD7);
+SFRBITS(TRISA, TRISA0);
+SFRBITS(TRISB, TRISB1, TRISB2, TRISB3, TRISB4, TRISB5);
+SFRBITS(TRISC, TRISC2, TRISC3, TRISC4, TRISC5);
+SFRBITS(TRISD, TRISD0, TRISD1, TRISD2, TRISD3, TRISD4, TRISD5, TRISD6, TRISD7);
+SFRBITS(TRISE, TRISE0, TRISE1, TRISE2);
+SFRBITS(ANSELA, ANSELA0);
+SFRBITS(ANSELB, ANSELB1, ANSELB2, ANSELB3, ANSELB4, ANSELB5);
+SFRBITS(ANSELC, ANSELC2, ANSELC3, ANSELC4, ANSELC5);
+SFRBITS(ANSELD, ANSELD0, ANSELD1, ANSELD2, ANSELD3, ANSELD4, ANSELD5, ANSELD6, ANSELD7);
+SFRBITS(ANSELE, ANSELE0, ANSELE1, ANSELE2);
+
+// Peripheral pin select outputs
+SFR8(RB2PPS); SFR8(RB3PPS); SFR8(RB4PPS); SFR8(RB5PPS);
+SFR8(RC2PPS); SFR8(RC3PPS); SFR8(RC4PPS); SFR8(RC5PPS);
+SFR8(RD0PPS); SFR8(RD1PPS); SFR8(RD2PPS); SFR8(RD3PPS);
+SFR8(RD4PPS); SFR8(RD5PPS); SFR8(RD6PPS); SFR8(RD7PPS);
+
+// Fixed voltage reference, DACs and ADC
+SFRBITS(FVRCON, EN, RDY, TSEN, TSRNG, ADFVR, CDAFVR);
+SFRBITS(DAC2CON, EN, PSS, NSS);
+SFRBITS(DAC3CON, EN, PSS, NSS);
+SFR8(DAC2DATL);
+SFR8(DAC3DATL);
+SFRBITS(ADCON0, ON, CS, FM, IC, GO);
+SFRBITS(ADCON2, ADMD);
+SFRBITS(ADREF, NREF, PREF);
+SFR8(ADACQ);
+SFR8(ADPCH);
+SFR16(ADRES);
+SFRBITS(PIR1, ADIF);
+
+// Op-amps
+SFRBITS(OPA1CON0, EN, UG);
+SFRBITS(OPA1CON1, GSEL, RESON, NSS);
+SFRBITS(OPA1CON2, PCH, NCH);
+SFRBITS(OPA1CON3, PSS);
+SFRBITS(OPA2CON0, EN, UG);
+SFRBITS(OPA2CON1, GSEL, RESON, NSS);
+SFRBITS(OPA2CON2, PCH, NCH);
+SFRBITS(OPA2CON3, PSS);
+
+// Comparators
+SFRBITS(CM1CON0, EN, POL, HYS, SYNC);
+SFRBITS(CM2CON0, EN, POL, HYS, SYNC);
+SFR8(CM1NCH); SFR8(CM1PCH);
+SFR8(CM2NCH); SFR8(CM2PCH);
+SFRBITS(CMOUT, MC1OUT, MC2OUT);
+
+// Configurable logic cells, selected through CLCSELECT
+typedef struct { uint8_t EN, MODE; } CLCnCONbits_t;
+typedef struct { uint8_t POL, G1POL, G2POL, G3POL, G4POL; } CLCnPOLbits_t;
+typedef struct {
+    CLCnCONbits_t con;
+    CLCnPOLbits_t pol;
+    uint8_t sel[4];
+    uint8_t gls[4];
+} emu_clc_t;
+EMU_EXTERN volatile emu_clc_t emu_clc[8];
+SFR8(CLCSELECT);
+#define CLCnCONbits (emu_clc[CLCSELECT & 7].con)
+#define CLCnPOLbits (emu_clc[CLCSELECT & 7].pol)
+#define CLCnSEL0 (emu_clc[CLCSELECT & 7].sel[0])
+#define CLCnSEL1 (emu_clc[CLCSELECT & 7].sel[1])
+#define CLCnSEL2 (emu_clc[CLCSELECT & 7].sel[2])
+#define CLCnSEL3 (emu_clc[CLCSELECT & 7].sel[3])
+#define CLCnGLS0 (emu_clc[CLCSELECT & 7].gls[0])
+#define CLCnGLS1 (emu_clc[CLCSELECT & 7].gls[1])
+#define CLCnGLS2 (emu_clc[CLCSELECT & 7].gls[2])
+#define CLCnGLS3 (emu_clc[CLCSELECT & 7].gls[3])
+SFRBITS(CLCDATA, CLC1OUT, CLC2OUT, CLC3OUT, CLC4OUT, CLC5OUT, CLC6OUT, CLC7OUT, CLC8OUT);
+
+// Universal timers
+SFRBITS(TUCHAIN, CH16AB);
+typedef struct { uint8_t ON, OM; } TU16CON0bits_t;
+typedef struct { uint8_t CLR, OSEN, RUN; } TU16CON1bits_t;
+typedef struct { uint8_t CSYNC, START, RESET, STOP; } TU16HLTbits_t;
+EMU_EXTERN volatile TU16CON0bits_t TU16ACON0bits, TU16BCON0bits;
+EMU_EXTERN volatile TU16CON1bits_t TU16ACON1bits, TU16BCON1bits;
+EMU_EXTERN volatile TU16HLTbits_t TU16AHLTbits, TU16BHLTbits;
+SFR8(TU16ACLK); SFR8(TU16APS); SFR8(TU16AERS);
+SFR16(TU16APR);
+SFR8(TU16BCLK); SFR8(TU16BPS); SFR8(TU16BERS);
+SFR16(TU16BPR);
+
+// Timer0
+SFRBITS(T0CON0, EN, MD16);
+SFRBITS(T0CON1, CS, ASYNC, CKPS);
+SFR8(TMR0H);
+SFR8(TMR0L);
+
+// Timer2, free running from MFINTOSC 31.25kHz only
+SFRBITS(T2CON, ON, CKPS, OUTPS);
+SFRBITS(T2HLT, PSYNC, MODE);
+SFRBITS(T2CLKCON, CS);
+SFR8(T2TMR);
+SFR8(T2PR);
+
+// Timer1, Timer3 and CCPs
+SFRBITS(T1CON, ON, CKPS, RD16);
+SFRBITS(T1CLK, CS);
+SFRBITS(T1GATE, GSS);
+SFRBITS(T1GCON, GE, GPOL);
+SFR16(TMR1);
+SFRBITS(T3CON, ON, CKPS, RD16);
+SFRBITS(T3CLK, CS);
+SFRBITS(T3GATE, GSS);
+SFRBITS(T3GCON, GE, GPOL);
+SFR16(TMR3);
+SFRBITS(CCP1CON, EN, MODE, OUT);
+SFRBITS(CCP1CAP, CTS);
+SFRBITS(CCP2CON, EN, MODE, OUT);
+SFRBITS(CCP2CAP, CTS);
+SFR8(CCP1PPS);
+SFR8(CCP2PPS);
+SFR16(CCPR1);
+SFR16(CCPR2);
+SFRBITS(PIR3, CCP1IF, TMR1IF, TMR1GIF);
+SFRBITS(PIR8, CCP2IF);
+
+// 16-bit PWM, slice 1 of PWM1 only
+SFRBITS(PWM1CON, EN, LD, ERSPOL);
+SFRBITS(PWM1S1CFG, MODE, POL1);
+SFR8(PWM1CLK);
+SFR8(PWM1CPRE);
+SFR8(PWM1ERS);
+SFR16(PWM1PR);
+SFR16(PWM1S1P1);
+
+#endif
@@ -0,0 +1,165 @@
+// proto_compare.cpp
+// Compare bytes-on-wire and round-trip time of the ASCII and binary
+// protocols for the same set of commands on one x2-timer node.
+// Only reading commands are used, plus a write of register 1
+// with its current value, so the node's configuration is unchanged.
+//
+// Usage: x2-proto-compare <tty> [baud] [repeats]
+//
+// 2026-10-18 First cut.
+
+#include "binproto_codec.hpp"
+#include "serial_port.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const int timeout_ms = 2000;
+
+struct Exchange {
+    std::size_t tx = 0;
+    std::size_t rx = 0;
+    double us = 0.0;
+    std::string text; // ASCII reply, or empty
+    x2::Frame frame;  // binary reply
+};
+
+bool is_final_line(const std::string& line)
+{
+    // Replies end with a line containing ok, fail or error.
+    auto ends_with = [&](const char* w) {
+        std::string s(w);
+        return line.size() >= s.size() && line.compare(line.size() - s.size(), s.size(), s) == 0;
+    };
+    return ends_with("ok") || ends_with("fail") || line.find("rror") != std::string::npos;
+}
+
+Exchange ascii_exchange(x2::SerialPort& port, const std::string& cmd)
+{
+    Exchange ex;
+    std::string out = cmd + "\r";
+    auto t0 = Clock::now();
+    port.write_all(out);
+    ex.tx = out.size();
+    std::string line;
+    std::uint8_t buf[256];
+    bool done = false;
+    // The version reply is a single line without a status word.
+    bool single_line = (cmd == "v");
+    while (!done) {
+        std::size_t n = port.read_some(buf, sizeof(buf), timeout_ms);
+        if (n == 0) throw std::runtime_error("time-out waiting for reply to '" + cmd + "'");
+        for (std::size_t i = 0; i < n; ++i) {
+            char c = static_cast<char>(buf[i]);
+            ex.rx++;
+            ex.text += c;
+            if (c == '\n') {
+                if (!line.empty() && (single_line || is_final_line(line))) done = true;
+                line.clear();
+            } else if (c != '\r') {
+                line += c;
+            }
+        }
+    }
+    ex.us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+    return ex;
+}
+
+Exchange binary_exchange(x2::SerialPort& port, const std::vector<std::uint8_t>& frame)
+{
+    Exchange ex;
+    x2::FrameDecoder dec;
+    auto t0 = Clock::now();
+    port.write_all(frame.data(), frame.size());
+    ex.tx = frame.size();
+    std::uint8_t b;
+    while (true) {
+        std::size_t n = port.read_some(&b, 1, timeout_ms);
+        if (n == 0) throw std::runtime_error("time-out waiting for binary reply");
+        ex.rx++;
+        if (auto f = dec.feed(b)) {
+            ex.frame = *f;
+            break;
+        }
+    }
+    ex.us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+    return ex;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <tty> [baud] [repeats]\n", argv[0]);
+        return 2;
+    }
+    long baud = (argc > 2) ? std::atol(argv[2]) : 115200;
+    int repeats = (argc > 3) ? std::atoi(argv[3]) : 20;
+    try {
+        x2::SerialPort port(argv[1], baud);
+        port.drain_input();
+        // The write is of the present value, so that nothing changes.
+        Exchange r1 = ascii_exchange(port, "r 1");
+        int16_t level_a = static_cast<int16_t>(std::atoi(r1.text.c_str()));
+        struct Case {
+            std::string name;
+            std::string ascii;
+            std::vector<std::uint8_t> binary;
+        };
+        std::vector<Case> cases = {
+            {"version", "v", x2::encode_frame(BP_OP_VERSION)},
+            {"numreg", "n", x2::encode_frame(BP_OP_NUMREG)},
+            {"read-all", "p", x2::encode_frame(BP_OP_READALL)},
+            {"read 1", "r 1", x2::encode_read(1)},
+            {"write 1", "s 1 " + std::to_string(level_a), x2::encode_write(1, level_a)},
+            {"adc 0", "c 0", x2::encode_adc(0)},
+        };
+        std::vector<Exchange> ascii(cases.size()), binary(cases.size());
+        for (std::size_t i = 0; i < cases.size(); ++i) {
+            for (int k = 0; k < repeats; ++k) {
+                Exchange ex = ascii_exchange(port, cases[i].ascii);
+                ascii[i].tx = ex.tx;
+                ascii[i].rx = ex.rx;
+                ascii[i].us += ex.us / repeats;
+            }
+        }
+        Exchange mode = ascii_exchange(port, "B");
+        if (mode.text.find("ok") == std::string::npos) throw std::runtime_error("node refused binary mode");
+        for (std::size_t i = 0; i < cases.size(); ++i) {
+            for (int k = 0; k < repeats; ++k) {
+                Exchange ex = binary_exchange(port, cases[i].binary);
+                if (ex.frame.status() != BP_OK) {
+                    throw std::runtime_error(cases[i].name + ": " + x2::status_text(ex.frame.status()));
+                }
+                binary[i].tx = ex.tx;
+                binary[i].rx = ex.rx;
+                binary[i].us += ex.us / repeats;
+            }
+        }
+        binary_exchange(port, x2::encode_frame(BP_OP_EXIT));
+        std::printf("%-10s %8s %8s %10s   %8s %8s %10s\n", "command",
+                    "ascii-tx", "ascii-rx", "ascii-us", "bin-tx", "bin-rx", "bin-us");
+        std::size_t total_ascii = 0, total_binary = 0;
+        for (std::size_t i = 0; i < cases.size(); ++i) {
+            std::printf("%-10s %8zu %8zu %10.0f   %8zu %8zu %10.0f\n", cases[i].name.c_str(),
+                        ascii[i].tx, ascii[i].rx, ascii[i].us,
+                        binary[i].tx, binary[i].rx, binary[i].us);
+            total_ascii += ascii[i].tx + ascii[i].rx;
+            total_binary += binary[i].tx + binary[i].rx;
+        }
+        std::printf("total bytes: ascii %zu, binary %zu\n", total_ascii, total_binary);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+// reply_test.c
+// Checks that the formatters in ../reply.c give exactly the text
+// of the printf formats that they replaced in the firmware replies,
+// and reports what they cost here against snprintf.
+// Run by 'make check'; exits nonzero on the first difference.
+//
+// The cost on the PIC18 itself needs an XC8 build; here we report
+// the time per call on this host and, as a measure that does not depend
+// on the machine, the number of subtraction steps that reply.c takes,
+// where the library formatter does one division per digit.
+//
+// 2026-10-18 First cut.
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "uart.h"
+#include "reply.h"
+
+// The firmware's output functions, writing to a buffer instead.
+static char out[256];
+static size_t nout = 0;
+
+void putch(char data)
+{
+    if (nout < sizeof(out) - 1) out[nout++] = data;
+    out[nout] = 0;
+}
+
+void putstr(const char* str)
+{
+    while (*str) putch(*str++);
+}
+
+static void clear(void)
+{
+    nout = 0;
+    out[0] = 0;
+}
+
+static int failures = 0;
+
+static void expect(const char* what, const char* want)
+{
+    if (strcmp(out, want) != 0 && failures++ < 10) {
+        fprintf(stderr, "%s: got \"%s\", want \"%s\"\n", what, out, want);
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static unsigned steps_uint(uint16_t v)
+{
+    // Passes through the inner loop of reply_uint(): one per unit of
+    // each digit but the last, plus the test that ends each digit.
+    unsigned n = 0;
+    for (uint16_t p = 10000; p >= 10; p /= 10) n += (v / p) % 10 + 1;
+    return n;
+}
+
+int main(void)
+{
+    char want[64];
+    // Every 16-bit value, as "%u" and "%d".
+    for (uint32_t v = 0; v <= 0xFFFF; ++v) {
+        clear(); reply_uint((uint16_t)v);
+        snprintf(want, sizeof(want), "%u", (unsigned)v);
+        expect("reply_uint", want);
+        clear(); reply_int((int16_t)v);
+        snprintf(want, sizeof(want), "%d", (int)(int16_t)v);
+        expect("reply_int", want);
+        clear(); reply_int_ok((int16_t)v);
+        snprintf(want, sizeof(want), "%d ok\n", (int)(int16_t)v);
+        expect("reply_int_ok", want);
+    }
+    // 32-bit values: the edges, each power of ten either side,
+    // and a spread between them.
+    static const uint32_t edges[] = {0, 1, 9, 10, 0x7FFFFFFFUL, 0x80000000UL,
+        0x80000001UL, 0xFFFFFFFEUL, 0xFFFFFFFFUL, 4294967295UL - 999999999UL};
+    for (size_t i = 0; i < sizeof(edges)/sizeof(edges[0]); ++i) {
+        uint32_t v = edges[i];
+        clear(); reply_ulong(v);
+        snprintf(want, sizeof(want), "%lu", (unsigned long)v);
+        expect("reply_ulong", want);
+        clear(); reply_long((int32_t)v);
+        snprintf(want, sizeof(want), "%ld", (long)(int32_t)v);
+        expect("reply_long", want);
+    }
+    for (uint32_t p = 1; p <= 1000000000UL; p *= 10) {
+        for (int d = -1; d <= 1; ++d) {
+            uint32_t v = p + (uint32_t)d;
+            clear(); reply_ulong(v);
+            snprintf(want, sizeof(want), "%lu", (unsigned long)v);
+            expect("reply_ulong", want);
+            clear(); reply_long(-(int32_t)v);
+            snprintf(want, sizeof(want), "%ld", -(long)v);
+            expect("reply_long", want);
+        }
+        if (p == 1000000000UL) break;
+    }
+    uint32_t x = 12345;
+    for (int i = 0; i < 100000; ++i) {
+        x = x * 1664525UL + 1013904223UL;
+        clear(); reply_long((int32_t)x);
+        snprintf(want, sizeof(want), "%ld", (long)(int32_t)x);
+        expect("reply_long", want);
+        clear(); reply_hex(x, 8);
+        snprintf(want, sizeof(want), "%08lX", (unsigned long)x);
+        expect("reply_hex", want);
+        clear(); reply_hex(x & 0xFFFF, 4);
+        snprintf(want, sizeof(want), "%04lX", (unsigned long)(x & 0xFFFF));
+        expect("reply_hex", want);
+    }
+    clear(); reply_register(7, -1234, "clock-corr-ppm");
+    expect("reply_register", "reg[7]=-1234 (clock-corr-ppm)\n");
+    clear(); reply_register(14, 65535, "pulse-period");
+    expect("reply_register", "reg[14]=65535 (pulse-period)\n");
+    if (failures) {
+        fprintf(stderr, "reply_test: %d differences\n", failures);
+        return 1;
+    }
+    //
+    // Cost, over every 16-bit value.
+    double t0 = now_ns();
+    for (uint32_t v = 0; v <= 0xFFFF; ++v) { clear(); reply_uint((uint16_t)v); }
+    double t1 = now_ns();
+    for (uint32_t v = 0; v <= 0xFFFF; ++v) { snprintf(want, sizeof(want), "%u", (unsigned)v); }
+    double t2 = now_ns();
+    unsigned long total = 0;
+    unsigned worst = 0;
+    for (uint32_t v = 0; v <= 0xFFFF; ++v) {
+        unsigned n = steps_uint((uint16_t)v);
+        total += n;
+        if (n > worst) worst = n;
+    }
+    printf("reply_test: all replies match printf\n");
+    printf("  16-bit value on this host: reply_uint %.1f ns, snprintf %.1f ns\n",
+           (t1 - t0) / 65536, (t2 - t1) / 65536);
+    printf("  reply_uint steps: mean %.1f, worst %u (snprintf: 5 divisions)\n",
+           (double)total / 65536, worst);
+    return 0;
+}
@@ -0,0 +1,124 @@
+// serial_port.cpp
+// 2026-10-18 First cut.
+
+#include "serial_port.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <termios.h>
+#include <unistd.h>
+
+namespace x2 {
+
+namespace {
+
+speed_t speed_for(long baud)
+{
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 500000: return B500000;
+        case 1000000: return B1000000;
+        case 2000000: return B2000000;
+        case 4000000: return B4000000;
+        default: throw std::runtime_error("unsupported baud rate " + std::to_string(baud));
+    }
+}
+
+std::runtime_error sys_error(const std::string& what)
+{
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+SerialPort::SerialPort(const std::string& path, long baud, bool rtscts)
+    : path_(path), fd_(-1), rtscts_(rtscts)
+{
+    fd_ = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd_ < 0) throw sys_error("cannot open " + path);
+    try {
+        set_baud(baud);
+    } catch (...) {
+        ::close(fd_);
+        throw;
+    }
+}
+
+SerialPort::~SerialPort()
+{
+    if (fd_ >= 0) ::close(fd_);
+}
+
+void SerialPort::set_baud(long baud)
+{
+    struct termios tio;
+    if (tcgetattr(fd_, &tio) != 0) throw sys_error("tcgetattr " + path_);
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    if (rtscts_) {
+        tio.c_cflag |= CRTSCTS;
+    } else {
+        tio.c_cflag &= ~CRTSCTS;
+    }
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    speed_t sp = speed_for(baud);
+    cfsetispeed(&tio, sp);
+    cfsetospeed(&tio, sp);
+    if (tcsetattr(fd_, TCSANOW, &tio) != 0) throw sys_error("tcsetattr " + path_);
+}
+
+void SerialPort::write_all(const std::uint8_t* data, std::size_t n)
+{
+    while (n > 0) {
+        ssize_t m = ::write(fd_, data, n);
+        if (m < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                struct pollfd pfd = {fd_, POLLOUT, 0};
+                ::poll(&pfd, 1, 100);
+                continue;
+            }
+            throw sys_error("write " + path_);
+        }
+        data += m;
+        n -= static_cast<std::size_t>(m);
+    }
+}
+
+void SerialPort::write_all(const std::string& s)
+{
+    write_all(reinterpret_cast<const std::uint8_t*>(s.data()), s.size());
+}
+
+std::size_t SerialPort::read_some(std::uint8_t* buf, std::size_t n, int timeout_ms)
+{
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    int r = ::poll(&pfd, 1, timeout_ms);
+    if (r < 0) {
+        if (errno == EINTR) return 0;
+        throw sys_error("poll " + path_);
+    }
+    if (r == 0) return 0;
+    ssize_t m = ::read(fd_, buf, n);
+    if (m < 0) {
+        if (errno == EAGAIN || errno == EINTR) return 0;
+        throw sys_error("read " + path_);
+    }
+    return static_cast<std::size_t>(m);
+}
+
+void SerialPort::drain_input()
+{
+    tcflush(fd_, TCIFLUSH);
+}
+
+} // namespace x2
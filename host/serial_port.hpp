@@ -0,0 +1,43 @@
+// serial_port.hpp
+// Minimal raw serial port for talking to x2-timer nodes from a Linux PC.
+//
+// 2026-10-18 First cut.
+
+#ifndef X2_SERIAL_PORT_HPP
+#define X2_SERIAL_PORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace x2 {
+
+class SerialPort {
+public:
+    // Opens the device in raw 8N1 mode at the given baud rate.
+    // Throws std::runtime_error if the device cannot be opened or configured.
+    SerialPort(const std::string& path, long baud, bool rtscts = true);
+    ~SerialPort();
+    SerialPort(const SerialPort&) = delete;
+    SerialPort& operator=(const SerialPort&) = delete;
+
+    int fd() const { return fd_; }
+    const std::string& path() const { return path_; }
+    void set_baud(long baud);
+    void write_all(const std::uint8_t* data, std::size_t n);
+    void write_all(const std::string& s);
+    // Waits up to timeout_ms for data and returns the number of bytes read,
+    // which is zero if the time-out expired.
+    std::size_t read_some(std::uint8_t* buf, std::size_t n, int timeout_ms);
+    // Discards anything that has arrived but not been read.
+    void drain_input();
+
+private:
+    std::string path_;
+    int fd_;
+    bool rtscts_;
+};
+
+} // namespace x2
+
+#endif
@@ -0,0 +1,255 @@
+// x2cli.cpp
+// Command-line supervisory client for one or more x2-timer nodes.
+//
+// Usage: x2-cli [-b baud] [-t timeout_ms] [-r repeats] [-i interval_ms]
+//               -n <tty>[@<addr>] [-n ...] <command> [args]
+// Commands: version, numreg, regs, get <i>, set <i> <v>,
+//           restore, save, factory, arm, arm-all, arm-bench [n],
+//           plan, adc <ch>, status, raw <text>
+//
+// The command goes to all nodes concurrently (nodes sharing a tty,
+// i.e. on one multidrop bus, take their turn) and the typed result
+// and latency are printed for each node.
+// With -r, the command is repeated, as for polling, and a latency
+// summary is printed at the end.
+// arm-all broadcasts an arm with early acknowledgement to all of the
+// nodes together and reports how soon each node was armed.
+// arm-bench arms each node n times (default 10) using its arm plan
+// and n times recomputing as it goes ('P live'), and compares the
+// latencies from command to armed that the node reports.
+// Each arm needs an event to end the shot, from a pulse generator
+// or the emulator's script.
+//
+// 2026-10-18 First cut.
+//            arm-all.
+//            status.
+//            arm-bench, plan.
+//            raw takes the words of its command as separate arguments.
+
+#include "x2client.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+void usage(const char* prog)
+{
+    std::fprintf(stderr,
+        "Usage: %s [-b baud] [-t timeout_ms] [-r repeats] [-i interval_ms]\n"
+        "          -n <tty>[@<addr>] [-n ...] <command> [args]\n"
+        "Commands: version, numreg, regs, get <i>, set <i> <v>,\n"
+        "          restore, save, factory, arm, arm-all, arm-bench [n],\n"
+        "          plan, adc <ch>, status, raw <text>\n", prog);
+}
+
+bool wait_until_idle(x2::Node& node, int timeout_ms)
+{
+    // The shot ends with the event and a 100 ms hold; 'x' is answered meanwhile.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (!node.status().armed) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+}
+
+int arm_bench(x2::Node& node, int n, int timeout_ms)
+{
+    int failures = 0;
+    for (const char* path : {"plan", "live"}) {
+        node.arm_plan(path);
+        x2::LatencyStats s;
+        for (int k = 0; k < n; ++k) {
+            x2::ArmAck a = node.arm_early();
+            if (!a.armed) {
+                std::printf("%s: %s: failed: %s\n", node.name().c_str(), path, a.message.c_str());
+                ++failures;
+                break;
+            }
+            s.add(a.latency_us);
+            if (!wait_until_idle(node, timeout_ms)) {
+                std::printf("%s: %s: no event within %d ms\n", node.name().c_str(), path, timeout_ms);
+                ++failures;
+                break;
+            }
+        }
+        std::printf("%s: %s: %u arms, latency min %.0f mean %.0f max %.0f us\n",
+                    node.name().c_str(), path, s.count, s.min_us, s.mean_us(), s.max_us);
+    }
+    node.arm_plan("plan");
+    return failures;
+}
+
+std::string describe(const std::string& what, const x2::Reply& r)
+{
+    if (what == "version") return x2::parse_version(r);
+    if (what == "numreg" || what == "adc") return std::to_string(x2::parse_count(r));
+    if (what == "get" || what == "set") return std::to_string(x2::parse_register(r));
+    if (what == "regs") {
+        std::string s;
+        for (auto v : x2::parse_registers(r)) s += (s.empty() ? "" : " ") + std::to_string(v);
+        return s;
+    }
+    if (what == "arm") {
+        x2::ArmResult a = x2::parse_arm(r);
+        std::string s = a.triggered ? "triggered" : "failed: " + a.message;
+        if (a.tof) s += " tof=" + std::to_string(*a.tof) + " pr=" + std::to_string(*a.pr);
+        if (a.ev4) s += " ev4=" + std::to_string(*a.ev4);
+        if (a.ev5) s += " ev5=" + std::to_string(*a.ev5);
+        if (a.late) s += " late=" + std::to_string(a.late);
+        if (a.jitter_ns) s += " jitter-ns=" + std::to_string(*a.jitter_ns);
+        return s;
+    }
+    if (what == "status") {
+        x2::Status st = x2::parse_status(r);
+        char buf[160];
+        std::snprintf(buf, sizeof(buf),
+            "%s mode=%d flag=%u tof=%u pr=%d shots=%u uptime=%.1fs reset=%d uart-errors=%u,%u,%u,%u",
+            st.armed ? "armed" : "idle", st.mode, st.flag, st.tof, st.pr, st.shots,
+            st.uptime_s(), st.reset_cause, st.framing_errors, st.overflow_errors, st.long_lines,
+            st.ring_overruns);
+        return buf;
+    }
+    if (what == "plan") {
+        x2::parse_ok(r);
+        return r.last();
+    }
+    if (what == "raw") {
+        std::string s;
+        for (const auto& line : r.lines) s += (s.empty() ? "" : " | ") + line;
+        return s;
+    }
+    x2::parse_ok(r);
+    return "ok";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    long baud = 115200;
+    int timeout_ms = 1000;
+    int repeats = 1;
+    int interval_ms = 0;
+    std::vector<std::string> specs;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:r:i:n:h")) != -1) {
+        switch (opt) {
+            case 'b': baud = std::atol(optarg); break;
+            case 't': timeout_ms = std::atoi(optarg); break;
+            case 'r': repeats = std::atoi(optarg); break;
+            case 'i': interval_ms = std::atoi(optarg); break;
+            case 'n': specs.push_back(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (specs.empty() || optind >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::string what = argv[optind];
+    std::vector<std::string> args(argv + optind + 1, argv + argc);
+    std::map<std::string, std::string> letters = {
+        {"version", "v"}, {"numreg", "n"}, {"regs", "p"}, {"get", "r"}, {"set", "s"},
+        {"restore", "R"}, {"save", "S"}, {"factory", "F"}, {"arm", "a"}, {"adc", "c"}, {"status", "x"},
+        {"plan", "P"}};
+    std::string cmd;
+    if (what == "arm-all" || what == "arm-bench") {
+        // Handled separately below.
+    } else if (what == "raw") {
+        if (args.empty()) { usage(argv[0]); return 2; }
+        // The command line may come as one argument or as several.
+        for (const auto& a : args) cmd += (cmd.empty() ? "" : " ") + a;
+    } else if (letters.count(what)) {
+        cmd = letters[what];
+        for (const auto& a : args) cmd += " " + a;
+    } else {
+        usage(argv[0]);
+        return 2;
+    }
+    try {
+        std::map<std::string, std::shared_ptr<x2::SerialPort>> ports;
+        std::vector<std::unique_ptr<x2::Node>> nodes;
+        for (const auto& spec : specs) {
+            std::size_t at = spec.rfind('@');
+            std::string path = spec.substr(0, at);
+            int address = (at == std::string::npos) ? 0 : std::atoi(spec.c_str() + at + 1);
+            if (!ports.count(path)) {
+                ports[path] = std::make_shared<x2::SerialPort>(path, baud);
+                ports[path]->drain_input();
+            }
+            nodes.push_back(std::make_unique<x2::Node>(ports[path], address, timeout_ms));
+        }
+        if (what == "arm-all") {
+            std::vector<x2::Node*> targets;
+            for (auto& n : nodes) targets.push_back(n.get());
+            auto acks = x2::broadcast_arm(targets, timeout_ms);
+            int failures = 0;
+            for (std::size_t i = 0; i < targets.size(); ++i) {
+                const auto& a = acks[i];
+                if (!a) {
+                    std::printf("%s: time-out\n", targets[i]->name().c_str());
+                } else if (a->armed) {
+                    std::printf("%s: armed in %u us (acknowledged after %.0f us)\n",
+                                targets[i]->name().c_str(), a->latency_us, a->received_us);
+                    continue;
+                } else {
+                    std::printf("%s: failed: %s (%.0f us)\n", targets[i]->name().c_str(),
+                                a->message.c_str(), a->received_us);
+                }
+                ++failures;
+            }
+            return failures ? 1 : 0;
+        }
+        if (what == "arm-bench") {
+            int n = args.empty() ? 10 : std::atoi(args[0].c_str());
+            int failures = 0;
+            for (auto& node : nodes) failures += arm_bench(*node, n, timeout_ms);
+            return failures ? 1 : 0;
+        }
+        std::vector<x2::PollRequest> requests;
+        for (auto& n : nodes) requests.push_back({n.get(), cmd});
+        x2::Poller poller;
+        int failures = 0;
+        for (int k = 0; k < repeats; ++k) {
+            auto t0 = std::chrono::steady_clock::now();
+            for (const auto& res : poller.run(requests)) {
+                if (!res.reply) {
+                    std::printf("%s: time-out\n", res.node->name().c_str());
+                    ++failures;
+                    continue;
+                }
+                try {
+                    std::printf("%s: %s (%.0f us)\n", res.node->name().c_str(),
+                                describe(what, *res.reply).c_str(), res.reply->latency_us);
+                } catch (const x2::CommandError& e) {
+                    std::printf("%s: fail: %s (%.0f us)\n", res.node->name().c_str(), e.what(),
+                                res.reply->latency_us);
+                    ++failures;
+                }
+            }
+            if (interval_ms > 0 && k + 1 < repeats) {
+                std::this_thread::sleep_until(t0 + std::chrono::milliseconds(interval_ms));
+            }
+        }
+        if (repeats > 1) {
+            for (auto& n : nodes) {
+                const x2::LatencyStats& s = n->latency();
+                std::printf("%s: %u replies, %u time-outs, latency min %.0f mean %.0f max %.0f us\n",
+                            n->name().c_str(), s.count, s.timeouts, s.min_us, s.mean_us(), s.max_us);
+            }
+        }
+        return failures ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+}
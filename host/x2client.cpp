@@ -0,0 +1,428 @@
+// x2client.cpp
+// 2026-10-18 First cut.
+//            Broadcast arm.
+//            Early-acknowledged arm and the arm plan.
+//            Receive ring overruns in the status.
+//            Register values up to 65535.
+
+#include "x2client.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <poll.h>
+
+namespace x2 {
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+bool ends_with(const std::string& s, const std::string& w)
+{
+    return s.size() >= w.size() && s.compare(s.size() - w.size(), w.size(), w) == 0;
+}
+
+bool is_final_line(const std::string& s)
+{
+    // Replies end with a line ending in ok or fail, or an error line.
+    return ends_with(s, "ok") || ends_with(s, "fail") || s.find("rror") != std::string::npos;
+}
+
+void throw_if_failed(const Reply& r)
+{
+    if (!r.ok) throw CommandError(r.lines.empty() ? "empty reply" : r.last());
+}
+
+double elapsed_us(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+}
+
+} // namespace
+
+std::string format_command(const std::string& cmd, int address, const std::string& tag)
+{
+    std::string line;
+    if (address > 0) line += "@" + std::to_string(address) + " ";
+    if (!tag.empty()) line += "#" + tag + " ";
+    line += cmd;
+    line += "\r";
+    return line;
+}
+
+std::string next_tag()
+{
+    static std::atomic<unsigned> counter{0};
+    return std::to_string(counter++ % 100000000u);
+}
+
+void ReplyAssembler::expect(const std::string& tag)
+{
+    tag_ = tag;
+    line_.clear();
+    reply_ = Reply();
+    in_reply_ = false;
+    done_ = false;
+}
+
+std::optional<Reply> ReplyAssembler::feed(char c)
+{
+    if (c == '\r') return std::nullopt;
+    if (c != '\n') {
+        line_ += c;
+        return std::nullopt;
+    }
+    take_line();
+    line_.clear();
+    if (done_) {
+        done_ = false;
+        in_reply_ = false;
+        return reply_;
+    }
+    return std::nullopt;
+}
+
+void ReplyAssembler::take_line()
+{
+    std::string s = line_;
+    std::size_t pos = 0;
+    // The first line of each reply carries the echoed address and tag.
+    if (!s.empty() && s[0] == '@') {
+        pos = s.find(' ');
+        pos = (pos == std::string::npos) ? s.size() : pos + 1;
+    }
+    if (pos < s.size() && s[pos] == '#') {
+        std::size_t end = s.find(' ', pos);
+        std::string tag = s.substr(pos + 1, (end == std::string::npos ? s.size() : end) - pos - 1);
+        if (tag != tag_) {
+            in_reply_ = false; // a stale reply; ignore it
+            return;
+        }
+        in_reply_ = true;
+        reply_ = Reply();
+        s = (end == std::string::npos) ? std::string() : s.substr(end + 1);
+    } else if (!in_reply_) {
+        return; // a blank line or the tail of a stale reply
+    }
+    reply_.lines.push_back(s);
+    // The version reply is a single line without a status word.
+    bool version = reply_.lines.size() == 1 && s.size() > 1 && s[0] == 'v' && s[1] >= '0' && s[1] <= '9';
+    if (is_final_line(s) || version) {
+        reply_.ok = ends_with(s, "ok") || version;
+        done_ = true;
+    }
+}
+
+std::string parse_version(const Reply& r)
+{
+    throw_if_failed(r);
+    return r.lines.front();
+}
+
+int parse_count(const Reply& r)
+{
+    throw_if_failed(r);
+    return std::atoi(r.last().c_str());
+}
+
+std::vector<std::int32_t> parse_registers(const Reply& r)
+{
+    throw_if_failed(r);
+    std::vector<std::int32_t> regs;
+    for (const auto& s : r.lines) {
+        // reg[i]=v (hint)
+        if (s.compare(0, 4, "reg[") != 0) continue;
+        std::size_t close = s.find("]=");
+        if (close == std::string::npos) continue;
+        std::size_t i = static_cast<std::size_t>(std::atoi(s.c_str() + 4));
+        if (regs.size() <= i) regs.resize(i + 1);
+        regs[i] = static_cast<std::int32_t>(std::atol(s.c_str() + close + 2));
+    }
+    return regs;
+}
+
+std::int32_t parse_register(const Reply& r)
+{
+    throw_if_failed(r);
+    const std::string& s = r.last();
+    // 'r' gives "v (hint) ok" while 's' gives "reg[i] v (hint) ok".
+    std::size_t pos = 0;
+    if (s.compare(0, 4, "reg[") == 0) {
+        pos = s.find("] ");
+        pos = (pos == std::string::npos) ? 0 : pos + 2;
+    }
+    return static_cast<std::int32_t>(std::atol(s.c_str() + pos));
+}
+
+void parse_ok(const Reply& r)
+{
+    throw_if_failed(r);
+}
+
+ArmResult parse_arm(const Reply& r)
+{
+    ArmResult a;
+    a.message = r.lines.empty() ? std::string() : r.last();
+    a.triggered = r.ok;
+    std::size_t t = a.message.find("tof=");
+    if (t != std::string::npos) {
+        a.tof = static_cast<std::uint16_t>(std::atol(a.message.c_str() + t + 4));
+        std::size_t p = a.message.find("pr=", t);
+        if (p != std::string::npos) a.pr = static_cast<std::int32_t>(std::atol(a.message.c_str() + p + 3));
+    }
+    std::size_t e = a.message.find("ev4=");
+    if (e != std::string::npos) a.ev4 = static_cast<std::uint16_t>(std::atol(a.message.c_str() + e + 4));
+    e = a.message.find("ev5=");
+    if (e != std::string::npos) a.ev5 = static_cast<std::uint16_t>(std::atol(a.message.c_str() + e + 4));
+    e = a.message.find("late=");
+    if (e != std::string::npos) a.late = static_cast<unsigned>(std::atol(a.message.c_str() + e + 5));
+    std::size_t j = a.message.find("jitter-ns=");
+    if (j != std::string::npos) {
+        a.jitter_ns = static_cast<std::uint16_t>(std::atol(a.message.c_str() + j + 10));
+    }
+    return a;
+}
+
+ArmAck parse_arm_ack(const std::string& line)
+{
+    ArmAck a;
+    a.message = line;
+    if (line.compare(0, 6, "armed ") == 0 && ends_with(line, "ok")) {
+        a.armed = true;
+        a.latency_us = static_cast<std::uint32_t>(std::strtoul(line.c_str() + 6, nullptr, 10));
+    }
+    return a;
+}
+
+Status parse_status(const Reply& r)
+{
+    // Twelve hexadecimal fields then "ok"; older nodes give eleven.
+    throw_if_failed(r);
+    const char* p = r.last().c_str();
+    unsigned long f[12] = {};
+    for (int i = 0; i < 12; ++i) {
+        char* end = nullptr;
+        f[i] = std::strtoul(p, &end, 16);
+        if (end == p) {
+            if (i == 11) break;
+            throw CommandError("malformed status: " + r.last());
+        }
+        p = end;
+    }
+    Status st;
+    st.armed = f[0] != 0;
+    st.mode = static_cast<int>(f[1]);
+    st.flag = static_cast<std::uint8_t>(f[2]);
+    st.tof = static_cast<std::uint16_t>(f[3]);
+    st.pr = static_cast<std::int16_t>(static_cast<std::uint16_t>(f[4]));
+    st.shots = static_cast<std::uint16_t>(f[5]);
+    st.uptime_ticks = static_cast<std::uint32_t>(f[6]);
+    st.reset_cause = static_cast<int>(f[7]);
+    st.framing_errors = static_cast<std::uint16_t>(f[8]);
+    st.overflow_errors = static_cast<std::uint16_t>(f[9]);
+    st.long_lines = static_cast<std::uint16_t>(f[10]);
+    st.ring_overruns = static_cast<std::uint16_t>(f[11]);
+    return st;
+}
+
+void LatencyStats::add(double us)
+{
+    if (count == 0 || us < min_us) min_us = us;
+    if (count == 0 || us > max_us) max_us = us;
+    sum_us += us;
+    ++count;
+}
+
+Node::Node(std::shared_ptr<SerialPort> port, int address, int timeout_ms)
+    : port_(std::move(port)), address_(address), timeout_ms_(timeout_ms)
+{
+}
+
+std::string Node::name() const
+{
+    return address_ > 0 ? port_->path() + "@" + std::to_string(address_) : port_->path();
+}
+
+Reply Node::command(const std::string& cmd, int timeout_ms)
+{
+    if (timeout_ms < 0) timeout_ms = timeout_ms_;
+    ReplyAssembler assembler;
+    std::string tag = next_tag();
+    assembler.expect(tag);
+    auto t0 = Clock::now();
+    auto deadline = t0 + std::chrono::milliseconds(timeout_ms);
+    port_->write_all(format_command(cmd, address_, tag));
+    std::uint8_t buf[256];
+    while (true) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (remaining <= 0) {
+            latency_.timeouts++;
+            throw TimeoutError(name() + ": no reply to '" + cmd + "'");
+        }
+        std::size_t n = port_->read_some(buf, sizeof(buf), static_cast<int>(remaining));
+        for (std::size_t i = 0; i < n; ++i) {
+            if (auto r = assembler.feed(static_cast<char>(buf[i]))) {
+                r->latency_us = elapsed_us(t0);
+                latency_.add(r->latency_us);
+                return *r;
+            }
+        }
+    }
+}
+
+std::string Node::version() { return parse_version(command("v")); }
+int Node::num_registers() { return parse_count(command("n")); }
+std::vector<std::int32_t> Node::registers() { return parse_registers(command("p")); }
+std::int32_t Node::read_register(int i) { return parse_register(command("r " + std::to_string(i))); }
+
+std::int32_t Node::write_register(int i, std::int32_t v)
+{
+    return parse_register(command("s " + std::to_string(i) + " " + std::to_string(v)));
+}
+
+void Node::restore_from_eeprom() { parse_ok(command("R")); }
+void Node::save_to_eeprom() { parse_ok(command("S")); }
+void Node::set_original_values() { parse_ok(command("F")); }
+ArmResult Node::arm(int timeout_ms) { return parse_arm(command("a", timeout_ms)); }
+
+ArmAck Node::arm_early()
+{
+    Reply r = command("A");
+    ArmAck a = parse_arm_ack(r.lines.empty() ? std::string() : r.last());
+    a.received_us = r.latency_us;
+    return a;
+}
+
+std::string Node::arm_plan(const std::string& path)
+{
+    Reply r = command(path.empty() ? "P" : "P " + path);
+    throw_if_failed(r);
+    return r.last();
+}
+std::uint16_t Node::adc(int channel) { return static_cast<std::uint16_t>(parse_count(command("c " + std::to_string(channel)))); }
+Status Node::status() { return parse_status(command("x")); }
+
+std::vector<std::optional<ArmAck>> broadcast_arm(const std::vector<Node*>& nodes, int timeout_ms)
+{
+    // Each acknowledgement is a line "@<address> <text>".
+    std::vector<std::optional<ArmAck>> acks(nodes.size());
+    std::map<SerialPort*, std::string> partial;
+    for (Node* n : nodes) partial[&n->port()];
+    auto t0 = Clock::now();
+    for (auto& kv : partial) kv.first->write_all("@* A\r");
+    auto deadline = t0 + std::chrono::milliseconds(timeout_ms);
+    std::size_t outstanding = nodes.size();
+    std::uint8_t buf[256];
+    while (outstanding > 0) {
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (wait <= 0) break;
+        std::vector<struct pollfd> pfds;
+        std::vector<SerialPort*> owners;
+        for (auto& kv : partial) {
+            pfds.push_back({kv.first->fd(), POLLIN, 0});
+            owners.push_back(kv.first);
+        }
+        ::poll(pfds.data(), pfds.size(), static_cast<int>(wait));
+        for (std::size_t k = 0; k < pfds.size(); ++k) {
+            if (!(pfds[k].revents & POLLIN)) continue;
+            SerialPort* port = owners[k];
+            std::string& line = partial[port];
+            std::size_t m = port->read_some(buf, sizeof(buf), 0);
+            for (std::size_t j = 0; j < m; ++j) {
+                char c = static_cast<char>(buf[j]);
+                if (c == '\r') continue;
+                if (c != '\n') { line += c; continue; }
+                std::size_t sp = line.find(' ');
+                if (line.size() > 1 && line[0] == '@' && sp != std::string::npos) {
+                    int address = std::atoi(line.c_str() + 1);
+                    for (std::size_t i = 0; i < nodes.size(); ++i) {
+                        if (&nodes[i]->port() != port || nodes[i]->address() != address || acks[i]) continue;
+                        acks[i] = parse_arm_ack(line.substr(sp + 1));
+                        acks[i]->received_us = elapsed_us(t0);
+                        --outstanding;
+                    }
+                }
+                line.clear();
+            }
+        }
+    }
+    return acks;
+}
+
+std::vector<PollResult> Poller::run(const std::vector<PollRequest>& requests)
+{
+    struct Pending {
+        std::size_t index;
+        Clock::time_point start;
+        Clock::time_point deadline;
+    };
+    struct PortState {
+        SerialPort* port = nullptr;
+        std::vector<std::size_t> queue; // request indices, in order
+        std::size_t next = 0;
+        std::optional<Pending> pending;
+        ReplyAssembler assembler;
+    };
+    std::vector<PollResult> results(requests.size());
+    std::map<SerialPort*, PortState> ports;
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        results[i].node = requests[i].node;
+        results[i].command = requests[i].command;
+        PortState& ps = ports[&requests[i].node->port()];
+        ps.port = &requests[i].node->port();
+        ps.queue.push_back(i);
+    }
+    std::uint8_t buf[256];
+    while (true) {
+        // Start the next command on every idle port.
+        for (auto& kv : ports) {
+            PortState& ps = kv.second;
+            if (ps.pending || ps.next >= ps.queue.size()) continue;
+            std::size_t i = ps.queue[ps.next++];
+            Node* node = requests[i].node;
+            std::string tag = next_tag();
+            ps.assembler.expect(tag);
+            auto now = Clock::now();
+            ps.pending = Pending{i, now, now + std::chrono::milliseconds(node->timeout_ms())};
+            ps.port->write_all(format_command(requests[i].command, node->address(), tag));
+        }
+        // Wait for replies on all ports with something outstanding.
+        std::vector<struct pollfd> pfds;
+        std::vector<PortState*> owners;
+        auto earliest = Clock::time_point::max();
+        for (auto& kv : ports) {
+            if (!kv.second.pending) continue;
+            pfds.push_back({kv.second.port->fd(), POLLIN, 0});
+            owners.push_back(&kv.second);
+            earliest = std::min(earliest, kv.second.pending->deadline);
+        }
+        if (pfds.empty()) break;
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(earliest - Clock::now()).count();
+        ::poll(pfds.data(), pfds.size(), static_cast<int>(std::max<long long>(0, wait)));
+        for (std::size_t k = 0; k < pfds.size(); ++k) {
+            PortState& ps = *owners[k];
+            if (pfds[k].revents & POLLIN) {
+                std::size_t n = ps.port->read_some(buf, sizeof(buf), 0);
+                for (std::size_t j = 0; j < n && ps.pending; ++j) {
+                    if (auto r = ps.assembler.feed(static_cast<char>(buf[j]))) {
+                        r->latency_us = elapsed_us(ps.pending->start);
+                        std::size_t i = ps.pending->index;
+                        requests[i].node->latency().add(r->latency_us);
+                        results[i].reply = *r;
+                        ps.pending.reset();
+                    }
+                }
+            }
+            if (ps.pending && Clock::now() >= ps.pending->deadline) {
+                requests[ps.pending->index].node->latency().timeouts++;
+                ps.pending.reset();
+            }
+        }
+    }
+    return results;
+}
+
+} // namespace x2
@@ -0,0 +1,194 @@
+// x2client.hpp
+// Supervisory client library for x2-timer nodes using the text protocol
+// of interpret_command() in the firmware.
+//
+// Every command is sent with a sequence tag, and with the node address
+// when the node is on a multidrop bus, so that replies can be matched
+// even when a late reply from an earlier, timed-out command turns up.
+// Node gives blocking, typed access to one node.
+// Poller sends commands to many nodes at once and collects the replies
+// with non-blocking I/O, each node having its own time-out.
+// broadcast_arm() arms many nodes together.
+//
+// 2026-10-18 First cut.
+//            Broadcast arm.
+//            Compact status, 'x'.
+//            Early-acknowledged arm and the arm plan, 'A' and 'P'.
+//            Receive ring overruns in the status.
+//            Register values up to 65535.
+
+#ifndef X2_CLIENT_HPP
+#define X2_CLIENT_HPP
+
+#include "serial_port.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace x2 {
+
+struct Reply {
+    std::vector<std::string> lines; // without address, tag or line ending
+    bool ok = false;                // final line ends with "ok"
+    double latency_us = 0.0;        // from sending the command to the final line
+    const std::string& last() const { return lines.back(); }
+};
+
+class TimeoutError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+class CommandError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Builds the line to send, e.g. "@3 #17 r 1\r".
+// Address 0 means a point-to-point node, which gets no address prefix.
+std::string format_command(const std::string& cmd, int address, const std::string& tag);
+
+// Collects incoming characters into the reply for one tagged command,
+// ignoring lines that belong to other (stale) replies.
+class ReplyAssembler {
+public:
+    void expect(const std::string& tag);
+    std::optional<Reply> feed(char c);
+
+private:
+    void take_line();
+    std::string tag_;
+    std::string line_;
+    Reply reply_;
+    bool in_reply_ = false;
+    bool done_ = false;
+};
+
+// Typed interpretation of replies; these throw CommandError on "fail" or "error".
+// Register values are int32 because a register may be signed, down to
+// -32768, or unsigned, up to 65535, as its schema says.
+std::string parse_version(const Reply& r);
+int parse_count(const Reply& r);                     // 'n', and the value of 'c'
+std::vector<std::int32_t> parse_registers(const Reply& r); // 'p'
+std::int32_t parse_register(const Reply& r);         // 'r' and 's'
+void parse_ok(const Reply& r);                       // 'R', 'S', 'F'
+
+struct ArmResult {
+    bool triggered = false;
+    std::string message;
+    std::optional<std::uint16_t> tof; // TOF mode only, 125ns ticks
+    std::optional<std::int32_t> pr;
+    std::optional<std::uint16_t> ev4;       // TOF mode, when wanted: ticks after Event1
+    std::optional<std::uint16_t> ev5;
+    unsigned late = 0;                      // bit k for Event(k+3) coming a roll-over late
+    std::optional<std::uint16_t> jitter_ns; // expected jitter of the outputs
+};
+ArmResult parse_arm(const Reply& r);
+
+// Acknowledgement of an early-acknowledged arm, 'A'.
+struct ArmAck {
+    bool armed = false;
+    std::uint32_t latency_us = 0; // the node's own time from command to armed
+    double received_us = 0.0;     // our time from sending the command to the reply
+    std::string message;
+};
+ArmAck parse_arm_ack(const std::string& line); // "armed 1234 ok" or a failure
+
+// Compact status, 'x', which a node answers even while armed after 'A'.
+struct Status {
+    bool armed = false;
+    int mode = 0;
+    std::uint8_t flag = 0xFF;       // of the last shot, 0xFF before the first
+    std::uint16_t tof = 0;          // of the last TOF shot, 125ns ticks
+    std::int16_t pr = 0;
+    std::uint16_t shots = 0;        // since reset, wrapping
+    std::uint32_t uptime_ticks = 0; // 4.096ms each
+    int reset_cause = 0;            // as listed by 'i'
+    std::uint16_t framing_errors = 0;
+    std::uint16_t overflow_errors = 0;
+    std::uint16_t long_lines = 0;
+    std::uint16_t ring_overruns = 0; // 0 from nodes that do not give it
+    double uptime_s() const { return uptime_ticks * 0.004096; }
+};
+Status parse_status(const Reply& r);
+
+struct LatencyStats {
+    unsigned count = 0;
+    unsigned timeouts = 0;
+    double min_us = 0.0;
+    double max_us = 0.0;
+    double sum_us = 0.0;
+    double mean_us() const { return count ? sum_us / count : 0.0; }
+    void add(double us);
+};
+
+class Node {
+public:
+    Node(std::shared_ptr<SerialPort> port, int address = 0, int timeout_ms = 1000);
+
+    SerialPort& port() { return *port_; }
+    std::shared_ptr<SerialPort> shared_port() const { return port_; }
+    int address() const { return address_; }
+    int timeout_ms() const { return timeout_ms_; }
+    std::string name() const;
+    LatencyStats& latency() { return latency_; }
+
+    // Sends any command and waits for its complete reply.
+    // Throws TimeoutError if the reply does not arrive in time.
+    Reply command(const std::string& cmd, int timeout_ms = -1);
+
+    std::string version();                      // 'v'
+    int num_registers();                        // 'n'
+    std::vector<std::int32_t> registers();      // 'p'
+    std::int32_t read_register(int i);          // 'r'
+    std::int32_t write_register(int i, std::int32_t v); // 's'
+    void restore_from_eeprom();                 // 'R'
+    void save_to_eeprom();                      // 'S'
+    void set_original_values();                 // 'F'
+    ArmResult arm(int timeout_ms);              // 'a', waits for the event
+    ArmAck arm_early();                         // 'A', returns once armed
+    std::string arm_plan(const std::string& path = ""); // 'P', or 'P live' or 'P plan'
+    std::uint16_t adc(int channel);             // 'c'
+    Status status();                            // 'x'
+
+private:
+    std::shared_ptr<SerialPort> port_;
+    int address_;
+    int timeout_ms_;
+    LatencyStats latency_;
+};
+
+std::string next_tag();
+
+// Arms all of the given nodes at once with "@* A" on each of their ports
+// and collects the acknowledgements, which the nodes of a multidrop bus
+// send in turn. The result is in the order of the nodes;
+// a node that has not answered within the time-out has no entry.
+std::vector<std::optional<ArmAck>> broadcast_arm(const std::vector<Node*>& nodes, int timeout_ms);
+
+struct PollRequest {
+    Node* node;
+    std::string command;
+};
+
+struct PollResult {
+    Node* node = nullptr;
+    std::string command;
+    std::optional<Reply> reply; // empty on time-out
+};
+
+// Runs a batch of requests concurrently across serial ports.
+// Requests to nodes sharing a port (a multidrop bus) go one at a time,
+// in order; different ports proceed in parallel.
+class Poller {
+public:
+    std::vector<PollResult> run(const std::vector<PollRequest>& requests);
+};
+
+} // namespace x2
+
+#endif
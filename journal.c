@@ -0,0 +1,167 @@
+// journal.c
+// Shot journal in the Storage Area Flash.
+//
+// Each record takes 8 words: six of data, their sum, and a commit word.
+// The data words and the sum are written together as one row,
+// and the commit word after them, so a reset part way through
+// leaves a record that does not count.
+// Such a torn slot is skipped, not rewritten, until its page is erased.
+//
+// The pages are used in turn, as a ring, and a page is erased only
+// when the journal moves into it, dropping the oldest 16 records.
+// So every page sees one erase per 128 shots.
+//
+// 2026-10-18 First cut.
+//            A queue of staged records, each written as a row and a commit word.
+
+#include "journal.h"
+#include "saf.h"
+
+#define WORDS_PER_RECORD 8
+#define RECORD_SIZE (2*WORDS_PER_RECORD)
+#define SLOTS_PER_PAGE (SAF_PAGE_SIZE / RECORD_SIZE)
+#define NPAGES (JOURNAL_SLOTS / SLOTS_PER_PAGE)
+#define JOURNAL_COMMIT 0xA55A
+
+static uint8_t head = 0; // next slot to be written
+static uint16_t next_seq = 0;
+static journal_record_t staged[JOURNAL_STAGED];
+static uint8_t staged_first = 0; // oldest staged record
+static uint8_t staged_count = 0;
+
+static uint32_t slot_address(uint8_t slot)
+{
+    return SAF_START + (uint32_t)slot * RECORD_SIZE;
+}
+
+static void read_words(uint8_t slot, uint16_t* w)
+{
+    uint32_t a = slot_address(slot);
+    for (uint8_t i=0; i < WORDS_PER_RECORD; ++i) {
+        w[i] = SAF_ReadWord(a + 2*i);
+    }
+}
+
+static uint16_t sum_words(const uint16_t* w)
+{
+    uint16_t sum = 0;
+    for (uint8_t i=0; i < 6; ++i) sum += w[i];
+    return sum;
+}
+
+static uint8_t slot_valid(const uint16_t* w)
+{
+    return w[7] == JOURNAL_COMMIT && w[6] == sum_words(w);
+}
+
+static uint8_t slot_blank(uint8_t slot)
+{
+    uint16_t w[WORDS_PER_RECORD];
+    read_words(slot, w);
+    for (uint8_t i=0; i < WORDS_PER_RECORD; ++i) {
+        if (w[i] != 0xFFFF) return 0;
+    }
+    return 1;
+}
+
+static uint8_t page_blank(uint8_t first_slot)
+{
+    for (uint8_t i=0; i < SLOTS_PER_PAGE; ++i) {
+        if (!slot_blank(first_slot + i)) return 0;
+    }
+    return 1;
+}
+
+void journal_init(void)
+{
+    // The newest record has the highest sequence number,
+    // compared so as to allow for the number wrapping around.
+    uint16_t w[WORDS_PER_RECORD];
+    uint8_t found = 0;
+    uint8_t newest = 0;
+    for (uint8_t slot=0; slot < JOURNAL_SLOTS; ++slot) {
+        read_words(slot, w);
+        if (!slot_valid(w)) continue;
+        if (!found || (int16_t)(w[0] - next_seq) >= 0) {
+            found = 1;
+            newest = slot;
+            next_seq = w[0] + 1;
+        }
+    }
+    head = found ? (uint8_t)((newest + 1) % JOURNAL_SLOTS) : 0;
+    if (!found) next_seq = 0;
+    // Step over any torn records left by a reset during a write.
+    // At a page boundary, journal_service() will erase the page if need be.
+    while ((head % SLOTS_PER_PAGE) != 0 && !slot_blank(head)) {
+        head = (uint8_t)((head + 1) % JOURNAL_SLOTS);
+    }
+}
+
+void journal_stage(const journal_record_t* r)
+{
+    if (staged_count == JOURNAL_STAGED) return;
+    staged[(staged_first + staged_count) % JOURNAL_STAGED] = *r;
+    staged_count++;
+}
+
+uint8_t journal_pending(void)
+{
+    return staged_count > 0;
+}
+
+static void write_record(const journal_record_t* r)
+{
+    if ((head % SLOTS_PER_PAGE) == 0 && !page_blank(head)) {
+        SAF_ErasePage(slot_address(head));
+    }
+    uint16_t w[WORDS_PER_RECORD];
+    w[0] = next_seq;
+    w[1] = (uint16_t)(r->mode | (r->flag << 8));
+    w[2] = r->tof;
+    w[3] = r->pr_value;
+    w[4] = (uint16_t)(r->level_a | (r->level_b << 8));
+    w[5] = r->delay_2;
+    w[6] = sum_words(w);
+    w[7] = JOURNAL_COMMIT;
+    uint32_t a = slot_address(head);
+    SAF_WriteRow(a, w, WORDS_PER_RECORD - 1);
+    SAF_WriteWord(a + 2*(WORDS_PER_RECORD - 1), w[7]); // the commit word goes last
+    head = (uint8_t)((head + 1) % JOURNAL_SLOTS);
+    next_seq++;
+}
+
+void journal_service(void)
+{
+    while (staged_count > 0) {
+        write_record(&staged[staged_first]);
+        staged_first = (uint8_t)((staged_first + 1) % JOURNAL_STAGED);
+        staged_count--;
+    }
+}
+
+uint8_t journal_read(uint8_t i, journal_record_t* r)
+{
+    // The oldest records are at the start of the page after the head's.
+    uint8_t oldest = (uint8_t)(((head / SLOTS_PER_PAGE + 1) % NPAGES) * SLOTS_PER_PAGE);
+    uint16_t w[WORDS_PER_RECORD];
+    read_words((uint8_t)((oldest + i) % JOURNAL_SLOTS), w);
+    if (!slot_valid(w)) return 0;
+    r->seq = w[0];
+    r->mode = (uint8_t)(w[1] & 0xFF);
+    r->flag = (uint8_t)(w[1] >> 8);
+    r->tof = w[2];
+    r->pr_value = w[3];
+    r->level_a = (uint8_t)(w[4] & 0xFF);
+    r->level_b = (uint8_t)(w[4] >> 8);
+    r->delay_2 = w[5];
+    return 1;
+}
+
+void journal_erase(void)
+{
+    for (uint8_t p=0; p < NPAGES; ++p) {
+        SAF_ErasePage(slot_address(p * SLOTS_PER_PAGE));
+    }
+    head = 0;
+    next_seq = 0;
+}
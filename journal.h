@@ -0,0 +1,47 @@
+// journal.h
+// An append-only journal of shot results in the Storage Area Flash,
+// so that the results survive a lost log on the PC or a reset of the node.
+//
+// 2026-10-18 First cut.
+//            A queue of staged records.
+
+#ifndef MY_JOURNAL
+#define MY_JOURNAL
+#include <stdint.h>
+
+typedef struct {
+    uint16_t seq; // counts up across resets
+    uint8_t mode; // register 0 at the time
+    uint8_t flag; // as returned by the trigger function
+    uint16_t tof; // 125ns ticks, TOF mode only
+    uint16_t pr_value;
+    uint8_t level_a; // registers 1 and 2
+    uint8_t level_b;
+    uint16_t delay_2; // register 6
+} journal_record_t;
+
+// Records are 16 bytes, so the 2kB SAF holds 128 of them.
+#define JOURNAL_SLOTS 128
+
+// Find the end of the journal; call once after reset.
+void journal_init(void);
+
+// Keep a record in SRAM for journal_service() to write later,
+// so that the flash writes stay out of the trigger path.
+// Up to JOURNAL_STAGED records wait; beyond that, the newest is lost.
+#define JOURNAL_STAGED 4
+void journal_stage(const journal_record_t* r);
+
+// Is there a staged record still to be written?
+uint8_t journal_pending(void);
+
+// Write the staged records, oldest first.
+void journal_service(void);
+
+// Read slot i, counting from the oldest; returns 1 if it holds a record.
+uint8_t journal_read(uint8_t i, journal_record_t* r);
+
+// Erase the whole journal.
+void journal_erase(void);
+
+#endif
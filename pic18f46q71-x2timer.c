@@ -7,8 +7,32 @@
 //     2024-07-15 Fixed delays implemented.
 //     2024-07-16 Add third delay to simple trigger and implement TOF trigger.
 //     2024-07-17 Refactor code for setting of latches.
+//     2026-10-18 Calibrate the HFINTOSC against an external reference.
+//                Replies go out by DMA.
+//                Command lines come in by DMA and are queued.
+//                Optional sequence tags on command lines.
+//                Compact binary protocol, entered with 'B'.
+//                Node addresses for a multidrop RS-485 bus.
+//                Selectable baud rate, with fall-back.
+//                Replies formatted without printf.
+//                Fast-boot option; report reset cause and boot time.
+//                Arm with early acknowledgement, also by broadcast.
+//                Verify output routing before enabling the latches.
+//                Output skew diagnostic.
+//                Hardware-timed pulse trains on selected outputs.
+//                Comparator crossing counter for noise diagnostics.
+//                Shot journal in the Storage Area Flash.
+//                Trigger levels optionally track the input baselines while armed.
+//                Optional op-amp gain stage on INa and INb.
+//                Compact status record for supervisory polling.
+//                Supply and temperature health scan; supply window for arming.
+//                Register schema with ranges and units; 's' checks values.
+//                Arm plan compiled when the registers change; 'P' shows it.
+//                Optional cycle-count probes on the hot paths, 'q' and 'Q'.
+//                Delay timers count FOSC where they fit, for less jitter; 'D' measures it.
+//                Up to three extrapolated events from one TOF measurement.
 //
-#define VERSION_STR "v0.10 PIC18F46Q71 X2-timer-ng build-3 2024-07-17"
+#define VERSION_STR "v0.33 PIC18F46Q71 X2-timer-ng build-3 2026-10-18"
 //
 // PIC18F46Q71 Configuration Bit Settings (generated in Memory View)
 // CONFIG1
@@ -53,7 +77,7 @@
 // BBSIZE = No Setting
 
 // CONFIG8
-#pragma config SAFSZ = SAFSZ_NONE
+#pragma config SAFSZ = SAFSZ_1024 // 2kB for the shot journal, see saf.h
 
 // CONFIG9
 #pragma config WRTB = OFF
@@ -75,7 +99,11 @@
 
 #include "uart.h"
 #include "eeprom.h"
-#include <stdio.h>
+#include "binproto.h"
+#include "reply.h"
+#include "journal.h"
+#include "saf.h"
+#include "profile.h"
 #include <string.h>
 
 #define LED0 LATEbits.LATE0
@@ -100,12 +128,11 @@
 #define OUT7b LATBbits.LATB5
 
 // Parameters controlling the device are stored in virtual registers.
-#define NUMREG 7
+#define NUMREG 30
 int16_t vregister[NUMREG]; // working copy in SRAM
-const char* hints[NUMREG] = { "mode",
-  "level-a", "level-b", "Vref",
-  "delay-0", "delay-1", "delay-2"
-}; 
+// Their names, ranges and units are in register_schema[], below.
+// Whatever changes them must then call arm_plan_compile(), also below.
+void arm_plan_compile(void);
 
 void set_registers_to_original_values()
 {
@@ -116,19 +143,185 @@ void set_registers_to_original_values()
     vregister[4] = 0;   // delay 0 as a 16-bit count
     vregister[5] = 0;   // delay 1
     vregister[6] = 0;   // delay 2
+    vregister[7] = 0;   // HFINTOSC correction in parts per million, as measured by 'k'
+    vregister[10] = 0;  // 1=skip the LED flashes and fixed waits at start-up
+    vregister[11] = 0;  // pulse outputs, bit k set for a pulse train on OUTk
+    vregister[12] = 10; // pulse count
+    vregister[13] = 80; // pulse width as a count of 125ns ticks
+    vregister[14] = 800; // pulse period, also in ticks
+    vregister[15] = 0;  // pulse start 0=with the event, 1=after delay 0, 2=after delay 1
+    vregister[16] = 0;  // tracking margin in DAC counts above the baseline, 0=fixed levels
+    vregister[17] = 1;  // largest change of a level per update, in DAC counts
+    vregister[18] = 10; // tracking update interval in ms, 1-1000
+    vregister[19] = 0;  // op-amp gain code for INa and INb, 0=no op-amps
+    vregister[20] = 0;  // lowest VDD for arming in mV, 0=no limit
+    vregister[21] = 0;  // highest VDD for arming in mV, 0=no limit
+    vregister[22] = 0;  // 0=delays count FOSC cycles where they fit, 1=125ns ticks only
+    vregister[23] = 0;  // TOF Event3 multiplier in sixteenths, 0=68 (4.25)
+    vregister[24] = 0;  // TOF Event4 multiplier in sixteenths, 0=no Event4
+    vregister[25] = 0;  // Event4 offset in ticks
+    vregister[26] = 0;  // Event4 outputs, bit k for OUTk
+    vregister[27] = 0;  // TOF Event5 multiplier in sixteenths, 0=no Event5
+    vregister[28] = 0;  // Event5 offset in ticks
+    vregister[29] = 0;  // Event5 outputs
+    // vregister[8], the node address, and vregister[9], the baud code,
+    // are left alone so that the node stays reachable.
+    arm_plan_compile();
+}
+
+// Baud rates selectable with register 9.
+// Each is within 1% with BRG computed from FOSC=64MHz.
+// 921600 baud is not available because it is 2% out.
+#define NBAUD 7
+const long baud_rates[NBAUD] = {115200, 230400, 460800, 500000,
+    1000000, 2000000, 4000000};
+
+long selected_baud_rate(void)
+{
+    int16_t code = vregister[9];
+    return (code >= 0 && code < NBAUD) ? baud_rates[code] : baud_rates[0];
+}
+
+// The clock correction is limited so that the scaling arithmetic
+// in corrected_count() cannot overflow 32 bits.
+// The HFINTOSC is specified to a couple of percent, so 3% is plenty.
+#define MAX_CLOCK_CORR_PPM 30000
+
+// Register schema: name, range, units and description of each register.
+// 's' and the binary write refuse values outside the range,
+// so that a bad value is caught when it is set rather than as a bad shot.
+// Registers with a maximum above 32767 hold 16-bit unsigned counts
+// in the int16_t slot and are reported as such.
+// Times and levels may also be set in physical units, see parse_register_value().
+#define UNIT_NONE 0
+#define UNIT_TICKS 1 // 125ns, also settable in ns or us
+#define UNIT_LEVEL 2 // DAC counts of Vref/256, also settable in mV
+#define UNIT_MV 3
+#define UNIT_MS 4
+#define UNIT_PPM 5
+const char* unit_names[6] = {"", "ticks", "counts", "mV", "ms", "ppm"};
+
+typedef struct {
+    const char* name;
+    int32_t min;
+    int32_t max;
+    uint8_t unit;
+    const char* help;
+} register_schema_t;
+
+const register_schema_t register_schema[NUMREG] = {
+    {"mode", 0, 1, UNIT_NONE,
+     "0= simple trigger from INa signal, 1= time-of-flight(TOF) trigger"},
+    {"level-a", 0, 255, UNIT_LEVEL, "trigger level for INa"},
+    {"level-b", 0, 255, UNIT_LEVEL, "trigger level for INb"},
+    {"Vref", 0, 3, UNIT_NONE,
+     "Vref selection for DACs 0=off, 1=1v024, 2=2v048, 3=4v096"},
+    {"delay-0", 0, 65535, UNIT_TICKS, "delay 0 (8 ticks per us)"},
+    {"delay-1", 0, 65535, UNIT_TICKS, "delay 1 (8 ticks per us)"},
+    {"delay-2", 0, 65535, UNIT_TICKS, "delay 2 (8 ticks per us)"},
+    {"clock-corr-ppm", -MAX_CLOCK_CORR_PPM, MAX_CLOCK_CORR_PPM, UNIT_PPM,
+     "HFINTOSC correction, applied to delays (set by k)"},
+    {"node-address", 0, 254, UNIT_NONE,
+     "node address on a multidrop bus, 0=point-to-point"},
+    {"baud-code", 0, NBAUD-1, UNIT_NONE,
+     "0=115200 1=230400 2=460800 3=500000 4=1M 5=2M 6=4M\n"
+     "    (read-only; set by b, which falls back if the host does not follow)"},
+    {"fast-boot", 0, 1, UNIT_NONE,
+     "0= flash LED at start-up (about 1.1 s)\n"
+     "    1= accept commands as soon as the peripherals are ready"},
+    {"pulse-outputs", 0, 255, UNIT_NONE,
+     "bit k set to put a pulse train on OUTk, 0=none"},
+    {"pulse-count", 1, 32767, UNIT_NONE, "pulses in a train"},
+    {"pulse-width", 1, 65533, UNIT_TICKS, "pulse width"},
+    {"pulse-period", 3, 65535, UNIT_TICKS,
+     "pulse period, at least width+2;\n"
+     "    count*period may be up to 65535 ticks (8.19 ms)"},
+    {"pulse-start", 0, 2, UNIT_NONE,
+     "0= with the event (Event3 in TOF mode)\n"
+     "    1= when delay 0 runs out, 2= when delay 1 runs out\n"
+     "    (with the event if that delay is 0)"},
+    {"track-margin", 0, 255, UNIT_LEVEL,
+     "0= levels fixed by registers 1 and 2\n"
+     "    n= while armed, keep the levels n counts above the baselines\n"
+     "    of INa and INb, measured with the ADC, until the event"},
+    {"track-step", 1, 255, UNIT_LEVEL,
+     "tracking step, the largest change of a level per update"},
+    {"track-interval-ms", 1, 1000, UNIT_MS, "tracking update interval"},
+    {"pga-gain", 0, 8, UNIT_NONE,
+     "op-amp gain for INa and INb: 0= off, inputs go straight to\n"
+     "    the comparators; 1= 16/15 2= 8/7 3= 4/3 4= 2 5= 8/3 6= 4 7= 8\n"
+     "    8= 16. Levels 1 and 2 then apply to the amplified signals."},
+    {"vdd-min-mV", 0, 5500, UNIT_MV,
+     "lowest VDD at which to arm, 0= no limit"},
+    {"vdd-max-mV", 0, 5500, UNIT_MV,
+     "highest VDD at which to arm, 0= no limit\n"
+     "    (measured on arming, which fails outside the window)"},
+    {"jitter-mode", 0, 1, UNIT_NONE,
+     "0= each delay that fits in 1.02 ms counts FOSC cycles (16 ns\n"
+     "    jitter) and longer delays count 125 ns ticks (125 ns jitter)\n"
+     "    1= all delays count 125 ns ticks. See 'D'."},
+    {"ev3-mult", 0, 255, UNIT_NONE,
+     "TOF mode: Event3 comes ev3-mult/16 times the TOF after Event1,\n"
+     "    plus delay 2; 0= 68, that is 4.25 times, for X2 AT4-AT7 sensors"},
+    {"ev4-mult", 0, 255, UNIT_NONE,
+     "TOF mode: Event4 comes ev4-mult/16 times the TOF after Event1,\n"
+     "    plus ev4-offset; 0= no Event4. It uses TU16A, so delay 0 must be 0"},
+    {"ev4-offset", 0, 65535, UNIT_TICKS, "added to the time of Event4"},
+    {"ev4-outputs", 0, 255, UNIT_NONE,
+     "outputs driven by Event4 rather than Event3, bit k for OUTk;\n"
+     "    OUT0 and OUT3 only, the outputs on port C"},
+    {"ev5-mult", 0, 255, UNIT_NONE,
+     "TOF mode: Event5 comes ev5-mult/16 times the TOF after Event1,\n"
+     "    plus ev5-offset; 0= no Event5. It uses TU16B, so delay 1 must be 0"},
+    {"ev5-offset", 0, 65535, UNIT_TICKS, "added to the time of Event5"},
+    {"ev5-outputs", 0, 255, UNIT_NONE,
+     "outputs driven by Event5, bit k for OUTk;\n"
+     "    any but OUT0 and OUT3, the outputs on ports B and D"}
+};
+
+int32_t register_value(uint8_t i)
+// The value of a register as the schema sees it.
+{
+    if (register_schema[i].max > 32767) return (uint16_t)vregister[i];
+    return vregister[i];
+}
+
+uint8_t register_read_only(uint8_t i)
+// The baud code is changed only with 'b', which confirms the new rate,
+// so that an unconfirmed code cannot be saved and leave the node unreachable.
+{
+    return i == 9;
+}
+
+uint8_t register_value_allowed(uint8_t i, int32_t v)
+{
+    return v >= register_schema[i].min && v <= register_schema[i].max;
 }
 
 // EEPROM is used to hold the parameters when the power is off.
 // Note little-endian layout.
 __EEPROM_DATA(0,0, 5,0, 5,0, 3,0);
 __EEPROM_DATA(0,0, 0,0, 0,0, 0,0);
+__EEPROM_DATA(0,0, 0,0, 0,0, 0,0);
+__EEPROM_DATA(10,0, 80,0, 0x20,0x03, 0,0);
+__EEPROM_DATA(0,0, 1,0, 10,0, 0,0);
+__EEPROM_DATA(0,0, 0,0, 0,0, 0,0);
+__EEPROM_DATA(0,0, 0,0, 0,0, 0,0);
+__EEPROM_DATA(0,0, 0,0, 0,0, 0,0);
+
+void save_register_to_EEPROM(uint8_t i)
+{
+    DATAEE_WriteByte(2*i, (char)(vregister[i] & 0x00FF));
+    DATAEE_WriteByte((2*i)+1, (char)((vregister[i] >> 8) & 0x00FF));
+}
 
 char save_registers_to_EEPROM()
 {
-    for (uint16_t i=0; i < NUMREG; ++i) {
-        DATAEE_WriteByte(2*i, (char)(vregister[i] & 0x00FF));
-        DATAEE_WriteByte((2*i)+1, (char)((vregister[i] >> 8) & 0x00FF));
+    PROBE_BEGIN(PROBE_EEPROM_SAVE);
+    for (uint8_t i=0; i < NUMREG; ++i) {
+        save_register_to_EEPROM(i);
     }
+    PROBE_END(PROBE_EEPROM_SAVE);
     return 0;
 }
 
@@ -137,9 +330,29 @@ char restore_registers_from_EEPROM()
     for (uint16_t i=0; i < NUMREG; ++i) {
         vregister[i] = (DATAEE_ReadByte((2*i)+1) << 8) | DATAEE_ReadByte(2*i);
     }
+    arm_plan_compile();
     return 0;
 }
 
+uint16_t corrected_count(uint16_t n)
+{
+    // Delay registers are counts of 125ns ticks, assuming FOSC is exactly 64MHz.
+    // If the calibration has found the oscillator to be fast by some ppm,
+    // we need proportionally more ticks to get the same real delay.
+    // The same goes for counts of FOSC cycles.
+    // A zero count still means "not delayed".
+    int32_t ppm = vregister[7];
+    if (n == 0 || ppm == 0) return n;
+    if (ppm > MAX_CLOCK_CORR_PPM) ppm = MAX_CLOCK_CORR_PPM;
+    if (ppm < -MAX_CLOCK_CORR_PPM) ppm = -MAX_CLOCK_CORR_PPM;
+    int32_t adj = (int32_t)n * ppm;
+    adj = (adj + ((adj < 0) ? -500000L : 500000L)) / 1000000L; // rounded
+    int32_t m = (int32_t)n + adj;
+    if (m < 1) m = 1;
+    if (m > 0xFFFF) m = 0xFFFF;
+    return (uint16_t)m;
+}
+
 void init_pins()
 {
     // Outputs for LEDs and debugging
@@ -205,6 +418,138 @@ void update_DACs()
     return;
 }
 
+// Op-amp gain stage, register 19.
+// OPA1 and OPA2 are non-inverting amplifiers with gains set by their
+// internal resistor ladders, and their outputs replace the input pins
+// at the comparators and the ADC, so the trigger levels apply
+// to the amplified signals.
+// Gains for GSEL 0 to 7 are 1 + R2/R1, Table 38-2 in the data sheet.
+#define NPGA 8
+const uint8_t pga_num[NPGA] = {16, 8, 4, 2, 8, 4, 8, 16};
+const uint8_t pga_den[NPGA] = {15, 7, 3, 1, 3, 1, 1, 1};
+#define ADC_OPA1_OUT 59 // ADC channels, Table 41-7
+#define ADC_OPA2_OUT 60
+
+uint8_t pga_on()
+{
+    return vregister[19] >= 1 && vregister[19] <= NPGA;
+}
+
+void update_PGAs()
+{
+    if (!pga_on()) {
+        OPA1CON0bits.EN = 0;
+        OPA2CON0bits.EN = 0;
+        return;
+    }
+    uint8_t gsel = (uint8_t)(vregister[19] - 1);
+    // OPA1 amplifies INa on RA0.
+    OPA1CON0bits.EN = 0;
+    OPA1CON2bits.PCH = 0b010; // OPA1IN+ pin selected by PSS
+    OPA1CON3bits.PSS = 0b00; // OPA1IN0+ (RA0)
+    OPA1CON2bits.NCH = 0b001; // tap of the resistor ladder
+    OPA1CON1bits.NSS = 0b111; // bottom of the ladder to VSS
+    OPA1CON1bits.GSEL = gsel;
+    OPA1CON1bits.RESON = 1;
+    OPA1CON0bits.UG = 0;
+    OPA1CON0bits.EN = 1;
+    // OPA2 amplifies INb on RB1.
+    OPA2CON0bits.EN = 0;
+    OPA2CON2bits.PCH = 0b010;
+    OPA2CON3bits.PSS = 0b01; // OPA2IN1+ (RB1)
+    OPA2CON2bits.NCH = 0b001;
+    OPA2CON1bits.NSS = 0b111;
+    OPA2CON1bits.GSEL = gsel;
+    OPA2CON1bits.RESON = 1;
+    OPA2CON0bits.UG = 0;
+    OPA2CON0bits.EN = 1;
+    __delay_us(10); // settle
+}
+
+uint8_t cm1_input()
+{
+    // CM1NCH selection for INa, Table 39-3.
+    return pga_on() ? 0b110 : 0b000; // OPA1_OUT or C1IN0- pin
+}
+
+uint8_t cm2_input()
+{
+    // CM2NCH selection for INb.
+    return pga_on() ? 0b111 : 0b011; // OPA2_OUT or C2IN3- pin
+}
+
+uint8_t comparator_adc_channel(uint8_t k)
+{
+    // The ADC channel that sees what comparator k+1 sees.
+    if (pga_on()) return (k == 0) ? ADC_OPA1_OUT : ADC_OPA2_OUT;
+    return (k == 0) ? 0 : 9; // RA0 (INa), RB1 (INb)
+}
+
+void set_register(uint8_t i, int16_t v)
+// Store a new register value and apply those that act immediately.
+{
+    vregister[i] = v;
+    if (i == 3) { update_FVRs(); }
+    if (i == 1 || i == 2) { update_DACs(); }
+    if (i == 19) { update_PGAs(); }
+    arm_plan_compile();
+}
+
+#define VALUE_OK 0
+#define VALUE_BAD 1 // not a number, or a unit that does not apply
+#define VALUE_OUT_OF_RANGE 2
+
+uint8_t parse_register_value(uint8_t i, const char* text, int32_t* v)
+// Reads a value for register i, converting from physical units if given:
+// ns or us for times in ticks, and mV for levels in DAC counts,
+// which uses the Vref (register 3) and gain (register 19) set at the time
+// and refers the level to the input pin.
+// The register's own unit is also accepted as a suffix, e.g. 20ms.
+{
+    char* end;
+    int32_t x = strtol(text, &end, 10);
+    if (end == text) return VALUE_BAD;
+    uint8_t unit = register_schema[i].unit;
+    if (*end) {
+        if (x < -100000000L || x > 100000000L) return VALUE_OUT_OF_RANGE;
+        if (unit == UNIT_TICKS && strcmp(end, "ns") == 0) {
+            x = (x + ((x < 0) ? -62 : 62)) / 125;
+        } else if (unit == UNIT_TICKS && strcmp(end, "us") == 0) {
+            if (x > 65535 || x < -65535) return VALUE_OUT_OF_RANGE;
+            x = x * 8;
+        } else if (unit == UNIT_LEVEL && strcmp(end, "mV") == 0) {
+            uint8_t vref = vregister[3] & 0x03;
+            if (vref == 0) return VALUE_BAD;
+            if (x < 0 || x > 5500) return VALUE_OUT_OF_RANGE;
+            uint32_t num = 256, den = (uint32_t)1024 << (vref - 1);
+            if (pga_on()) {
+                num *= pga_num[vregister[19] - 1];
+                den *= pga_den[vregister[19] - 1];
+            }
+            x = (int32_t)(((uint32_t)x * num + den/2) / den);
+        } else if (unit == UNIT_NONE || strcmp(end, unit_names[unit]) != 0) {
+            return VALUE_BAD;
+        }
+    }
+    if (!register_value_allowed(i, x)) return VALUE_OUT_OF_RANGE;
+    *v = x;
+    return VALUE_OK;
+}
+
+void reply_value_rejected(uint8_t i, uint8_t why)
+{
+    if (why == VALUE_BAD) {
+        putstr("bad value or unit for ");
+        putstr(register_schema[i].name);
+    } else {
+        putstr("out of range ");
+        reply_long(register_schema[i].min);
+        putstr("..");
+        reply_long(register_schema[i].max);
+    }
+    putstr(". fail\n");
+}
+
 void ADC_init()
 {
     ADCON0bits.IC = 0; // single-ended mode
@@ -231,12 +576,102 @@ uint16_t ADC_read(uint8_t i)
     return ADRES;
 }
 
+uint8_t ADC_channel_allowed(uint8_t i)
+{
+    // ADC Positive Input Channel Selections from Table 41-7 in the data sheet.
+    return (i == 0 || i == 9 || i == 57 || i == 58 ||
+            i == ADC_OPA1_OUT || i == ADC_OPA2_OUT);
+}
+
+uint16_t ADC_read_input(uint8_t i)
+{
+    // As ADC_read(), except that with the gain stage on, INa and INb
+    // are read at the op-amp outputs and divided by the gain,
+    // to give counts at the input pins.
+    if (!pga_on() || (i != 0 && i != 9)) return ADC_read(i);
+    uint8_t g = (uint8_t)(vregister[19] - 1);
+    uint32_t v = ADC_read((i == 0) ? ADC_OPA1_OUT : ADC_OPA2_OUT);
+    return (uint16_t)((v * pga_den[g] + pga_num[g]/2) / pga_num[g]);
+}
+
 void ADC_close()
 {
     ADCON0bits.ON = 0;
     return;
 }
 
+// Supply and temperature, which the FVR, the DAC levels and the
+// HFINTOSC timing all drift with.
+// FVR buffer 1 at 1.024V, converted against VDD as the ADC reference,
+// gives VDD, and the other channels are then scaled by VDD.
+// The calibration values come from the Device Information Area.
+#define ADC_TEMPERATURE 61 // ADC channels, Table 41-7
+#define ADC_FVR_BUFFER1 62
+#define TEMP_GAIN_UV_PER_C 3684 // low range, falling with temperature
+uint16_t fvr1x_mV = 1024;
+uint16_t vdd_mV = 0;
+int16_t temperature_dC = 0; // tenths of a degree
+uint8_t temperature_calibrated = 0;
+uint16_t input_mV[2];
+
+uint16_t measure_VDD()
+{
+    // Leaves the ADC referenced to VDD; ADC_reference_FVR() puts it back.
+    fvr1x_mV = DIA_ReadWord(DIA_FVRA1X);
+    if (fvr1x_mV < 900 || fvr1x_mV > 1150) fvr1x_mV = 1024; // blank DIA
+    FVRCONbits.ADFVR = 0b01; // 1x, leaving the DACs' buffer alone
+    FVRCONbits.EN = 1;
+    while (!FVRCONbits.RDY) { /* should be less than 25 microseconds */ }
+    ADREFbits.PREF = 0b00; // positive reference is VDD
+    __delay_us(20); // for the buffer to settle after the change of gain
+    uint16_t count = ADC_read(ADC_FVR_BUFFER1);
+    if (count == 0) return 0;
+    return (uint16_t)(((uint32_t)fvr1x_mV * 4096 + count/2) / count);
+}
+
+void ADC_reference_FVR()
+{
+    update_FVRs();
+    ADREFbits.PREF = 0b11; // positive reference is FVR, as in ADC_init()
+}
+
+uint8_t supply_in_window()
+{
+    // Registers 20 and 21; with both 0, VDD is not measured.
+    if (vregister[20] <= 0 && vregister[21] <= 0) return 1;
+    vdd_mV = measure_VDD();
+    ADC_reference_FVR();
+    if (vregister[20] > 0 && vdd_mV < (uint16_t)vregister[20]) return 0;
+    if (vregister[21] > 0 && vdd_mV > (uint16_t)vregister[21]) return 0;
+    return 1;
+}
+
+void health_scan()
+{
+    // One pass over VDD, the inputs and the die temperature.
+    // The temperature indicator is calibrated by its reading at 90C
+    // against the 2.048V FVR, which is 0.5mV per count, so we scale
+    // our reading to those counts and apply the typical gain,
+    // Section 42 of the data sheet.
+    update_PGAs(); // so that the inputs read as 'c' reads them
+    FVRCONbits.TSRNG = 0; // low range, good for VDD from 1.8V
+    FVRCONbits.TSEN = 1;
+    vdd_mV = measure_VDD();
+    for (uint8_t k=0; k < 2; ++k) {
+        uint32_t count = ADC_read_input((k == 0) ? 0 : 9);
+        input_mV[k] = (uint16_t)((count * vdd_mV + 2048) / 4096);
+    }
+    __delay_us(25); // acquisition for the indicator's high source impedance
+    uint32_t count = ADC_read(ADC_TEMPERATURE);
+    int32_t half_mV = (int32_t)((count * vdd_mV * 2 + 2048) / 4096);
+    uint16_t cal = DIA_ReadWord(DIA_TSLR2);
+    temperature_calibrated = (cal != 0xFFFF);
+    int32_t d = half_mV - (int32_t)cal;
+    temperature_dC = (int16_t)(900 - (d * 5000) / TEMP_GAIN_UV_PER_C);
+    FVRCONbits.TSEN = 0;
+    ADC_reference_FVR();
+}
+
 void setup_CLCn_as_latch(uint8_t n, uint8_t source_S)
 {
     // Follow the set-up description in Section 24.6 of data sheet.
@@ -265,10 +700,714 @@ void setup_CLCn_as_latch(uint8_t n, uint8_t source_S)
     CLCnCONbits.MODE = 0b011;
     // Do not invert output.
     CLCnPOLbits.POL = 0;
-    // Finally, enable latch.
-    CLCnCONbits.EN = 1;
+    // The latch is left disabled, with its output low,
+    // until the outputs have been routed. See enable_CLCn().
 } // end setup_CLCn_as_latch()
 
+void enable_CLCn(uint8_t n)
+{
+    CLCSELECT = n-1;
+    CLCnCONbits.EN = 1;
+}
+
+// Sources for the output pairs OUT0 to OUT7, as RxyPPS codes
+// from Table 23-2 in the data sheet; 0 connects the port latch.
+const uint8_t no_outputs[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+uint8_t route_outputs(const uint8_t* src)
+{
+    // Connect all of the output pins under one PPS unlock.
+    // The trigger functions do this while the latches are disabled,
+    // so that an early event cannot find the routing half done,
+    // and then check that the routing is as intended.
+    //
+    // Returns:
+    // 0 if the selections read back as written and the pins are low,
+    // 1 if a selection did not read back,
+    // 2 if a pin is already high.
+    uint8_t result = 0;
+    PROBE_BEGIN(PROBE_ROUTE);
+    GIE = 0; // We run without interrupt.
+    PPSLOCK = 0x55;
+    PPSLOCK = 0xaa;
+    PPSLOCKED = 0;
+    RC2PPS = src[0]; RC3PPS = src[0]; // OUT0
+    RD0PPS = src[1]; RD1PPS = src[1]; // OUT1
+    RD2PPS = src[2]; RD3PPS = src[2]; // OUT2
+    RC4PPS = src[3]; RC5PPS = src[3]; // OUT3
+    RD4PPS = src[4]; RD5PPS = src[4]; // OUT4
+    RD6PPS = src[5]; RD7PPS = src[5]; // OUT5
+    RB2PPS = src[6]; RB3PPS = src[6]; // OUT6
+    RB4PPS = src[7]; RB5PPS = src[7]; // OUT7
+    PPSLOCK = 0x55;
+    PPSLOCK = 0xaa;
+    PPSLOCKED = 1;
+    if (RC2PPS != src[0] || RC3PPS != src[0] || RD0PPS != src[1] || RD1PPS != src[1] ||
+        RD2PPS != src[2] || RD3PPS != src[2] || RC4PPS != src[3] || RC5PPS != src[3] ||
+        RD4PPS != src[4] || RD5PPS != src[4] || RD6PPS != src[5] || RD7PPS != src[5] ||
+        RB2PPS != src[6] || RB3PPS != src[6] || RB4PPS != src[7] || RB5PPS != src[7]) {
+        result = 1;
+    } else if (PORTCbits.RC2 || PORTCbits.RC3 || PORTDbits.RD0 || PORTDbits.RD1 ||
+        PORTDbits.RD2 || PORTDbits.RD3 || PORTCbits.RC4 || PORTCbits.RC5 ||
+        PORTDbits.RD4 || PORTDbits.RD5 || PORTDbits.RD6 || PORTDbits.RD7 ||
+        PORTBbits.RB2 || PORTBbits.RB3 || PORTBbits.RB4 || PORTBbits.RB5) {
+        result = 2;
+    }
+    PROBE_END(PROBE_ROUTE);
+    return result;
+}
+
+// Jitter of the delayed outputs, from one shot to the next.
+// The event is asynchronous to FOSC. Each delay timer is started by
+// a latched edge of it and synchronises the start to the clock it counts
+// (CSYNC for TU16A and TU16B, the gate synchroniser for Timer1),
+// so the delay varies by up to one period of that clock:
+//
+//   path                   clock          tick     longest   jitter
+//   TU16A/B, delays 0, 1   FOSC/8 (PS=7)  125ns    8.19ms    125ns
+//                          FOSC (PS=0)    15.6ns   1.02ms    16ns
+//   Timer1 gate, delay 2   FOSC/4 1:2     125ns    8.19ms    125ns
+//                          FOSC 1:1       15.6ns   1.02ms    16ns
+//   TOF Event3 to Event5   FOSC/4 1:2     125ns              656ns
+//
+// In TOF mode, the TOF is counted in 125ns ticks, so it may be one tick
+// short, and an extrapolated event comes m/16 times that plus one tick
+// for the compare, 5.25 ticks in all for 4.25 times, after Event1;
+// delays 0 and 1 add their own jitter.
+// Each delay counts FOSC if it still fits its 16-bit timer, otherwise
+// 125ns ticks; register 22 set to 1 keeps them all at 125ns ticks.
+// The outputs that are not delayed come straight from the comparator
+// latches and have no clock in their path.
+//
+// CSYNC stays set. Without it, a start that comes near a clock edge
+// may be counted from that edge or the next, or lost altogether,
+// which is worse than a clock period of jitter. 'D' measures the spread
+// of the TU16 delays with and without it, and at both clocks;
+// Timer1 is not measured, because it is then the measuring clock.
+#define JITTER_TICK_NS 125
+#define JITTER_FOSC_NS 16
+#define FINE_MAX_TICKS 8191 // longest delay that fits 16 bits in FOSC cycles
+
+// The arm plan: the values that the trigger functions write to the
+// peripherals and that depend on the registers, worked out by
+// arm_plan_compile() whenever the registers change, so that arming
+// only has to copy them into place. The trigger functions do not change it.
+#define PLAN_NO_OPA 0xFF
+typedef struct {
+    uint8_t mode; // register 0
+    uint8_t fvr_gain; // FVRCON ADFVR and CDAFVR
+    uint8_t dac[2]; // DAC2DATL and DAC3DATL, before any tracking
+    uint8_t opa_gsel; // OPA1CON1 and OPA2CON1 GSEL, or PLAN_NO_OPA
+    uint8_t cm_nch[2]; // CM1NCH and CM2NCH
+    uint16_t delay[3]; // corrected counts for delays 0 to 2, 0 for none;
+                       // the TU16xPR take one less. In TOF mode,
+                       // delay[2] is added to the computed CCPR2.
+    uint8_t fine; // bit k set if delay[k] counts FOSC cycles, not 125ns ticks
+    uint8_t ev_mult[3]; // TOF mode: Event3 to Event5 come ev_mult/16 times
+    uint16_t ev_offset[3]; // the TOF, plus ev_offset ticks, after Event1;
+                           // ev_mult is 0 for an event not wanted.
+    uint8_t ev_fault; // 1 if Event4 or Event5 clashes with a delay
+                      // or cannot reach its outputs
+    uint16_t jitter_ns; // expected jitter of the outputs, see above
+    uint8_t pulse_mask; // register 11
+    uint8_t pulse_fault; // 1 if the pulse train does not fit
+    uint8_t pulse_start; // CLC6SEL0
+    uint16_t pwm_pr; // PWM1PR
+    uint16_t pwm_p1; // PWM1S1P1
+    uint16_t tmr3; // TMR3 preset
+    uint8_t pps[8]; // RxyPPS for OUT0 to OUT7
+} arm_plan_t;
+arm_plan_t arm_plan;
+
+// Pulse trains, for outputs selected with register 11.
+// PWM1 makes the pulses, in 125ns ticks, and is held in reset,
+// with its output low, except while CLC6 holds the burst window open.
+// CLC6 is a D flip-flop clocked by the start signal, so a start signal
+// that stays high cannot open the window a second time.
+// Timer3 counts while the window is open and its overflow resets CLC6
+// half way through the gap after the last pulse.
+// No edge of the train passes through software.
+#define PPS_PWM1S1P1 0x0F // RxyPPS code, Table 23-2; reaches ports B, C, D
+uint8_t pulse_train_set_up = 0; // 1 while Timer3 holds the window
+
+void apply_pulse_outputs(uint8_t* src)
+{
+    uint8_t mask = (uint8_t)vregister[11];
+    for (uint8_t k=0; k < 8; k++) {
+        if (mask & (1 << k)) src[k] = PPS_PWM1S1P1;
+    }
+}
+
+uint8_t plan_pulse_train(arm_plan_t* p)
+{
+    // Returns:
+    // 0 if planned, or if no output wants a pulse train,
+    // 1 if the count, width and period do not make a train
+    //   that fits the 16-bit window timer (8.19ms).
+    if (p->pulse_mask == 0) return 0;
+    uint16_t n = (uint16_t)vregister[12];
+    uint16_t width = (uint16_t)vregister[13];
+    uint16_t period = (uint16_t)vregister[14];
+    if (n == 0 || width == 0 || period == 0) return 1;
+    if (period < width + 2) return 1; // need a gap of 2 ticks to end the window
+    uint32_t window = (uint32_t)n * period - (period - width)/2;
+    if (window > 0xFFFF) return 1;
+    p->pwm_pr = period - 1;
+    p->pwm_p1 = width;
+    p->tmr3 = (uint16_t)(0x10000UL - window);
+    return 0;
+}
+
+void setup_pulse_train(void)
+{
+    // From the plan, whose pulse_start is the CLC input selection
+    // (Table 24-2) whose rising edge starts the train.
+    if (arm_plan.pulse_mask == 0) return;
+    PROFILE_CLOCK_LOST(); // Timer3 is needed for the window
+    pulse_train_set_up = 1;
+    //
+    // CLC6 holds the window, D flip-flop clocked by data1, reset by data2.
+    CLCSELECT = 5;
+    CLCnCONbits.EN = 0;
+    CLCnSEL0 = arm_plan.pulse_start; // data1
+    CLCnSEL1 = 0x10; // data2 is TMR3 overflow (table 24-2)
+    CLCnSEL2 = 0;
+    CLCnSEL3 = 0;
+    CLCnGLS0 = 0b10; // data1 goes through true to gate 1 (clock)
+    CLCnGLS1 = 0; // gate 2 gets logic 0, inverted below (D)
+    CLCnGLS2 = 0b1000; // data2 goes through true to gate 3 (reset)
+    CLCnGLS3 = 0; // gate 4 gets logic 0 (set)
+    CLCnPOLbits.G1POL = 0;
+    CLCnPOLbits.G2POL = 1; // D is held high
+    CLCnPOLbits.G3POL = 0;
+    CLCnPOLbits.G4POL = 0;
+    CLCnCONbits.MODE = 0b100; // 1-input D flip-flop with S and R
+    CLCnPOLbits.POL = 0;
+    // Left disabled until the outputs are routed.
+    //
+    // Timer3 counts 125ns ticks while CLC6_OUT is high,
+    // from a preset such that it overflows as the window should close.
+    T3CONbits.ON = 0;
+    T3CLKbits.CS = 0b00001; // FOSC/4
+    T3CONbits.CKPS = 0b01; // prescale 1:2 to get 125ns ticks
+    T3CONbits.RD16 = 1;
+    T3GATEbits.GSS = 0b10111; // CLC6_OUT
+    T3GCONbits.GPOL = 1; // timer gate is active high
+    T3GCONbits.GE = 1;
+    TMR3 = arm_plan.tmr3;
+    T3CONbits.ON = 1;
+    //
+    // PWM1 slice 1, left aligned, so each period starts with the pulse.
+    PWM1CONbits.EN = 0;
+    PWM1CLK = 0b0010; // FOSC
+    PWM1CPRE = 7; // With FOSC=64MHz, we want 125ns ticks
+    PWM1PR = arm_plan.pwm_pr;
+    PWM1S1P1 = arm_plan.pwm_p1;
+    PWM1S1CFGbits.MODE = 0b000; // left aligned
+    PWM1S1CFGbits.POL1 = 0;
+    PWM1ERS = 0b10011; // CLC6_OUT
+    PWM1CONbits.ERSPOL = 1; // held in reset while the window is low
+    PWM1CONbits.LD = 1;
+    PWM1CONbits.EN = 1;
+} // end setup_pulse_train()
+
+void close_pulse_train()
+{
+    // Timer3 is handed back to the probes only if the train took it,
+    // so that an arm without a train leaves the probe clock running.
+    PWM1CONbits.EN = 0;
+    CLCSELECT = 5;
+    CLCnCONbits.EN = 0;
+    if (!pulse_train_set_up) return;
+    T3CONbits.ON = 0;
+    pulse_train_set_up = 0;
+    PROFILE_CLOCK_RESTART();
+}
+
+void arm_plan_compile(void)
+{
+    arm_plan_t* p = &arm_plan;
+    uint8_t mode = (uint8_t)vregister[0];
+    p->mode = mode;
+    p->fvr_gain = vregister[3] & 0x03;
+    p->dac[0] = (uint8_t)vregister[1];
+    p->dac[1] = (uint8_t)vregister[2];
+    p->opa_gsel = pga_on() ? (uint8_t)(vregister[19] - 1) : PLAN_NO_OPA;
+    p->cm_nch[0] = cm1_input();
+    p->cm_nch[1] = cm2_input();
+    // In TOF mode, delay 2 is added to the Event3 compare, in Timer1 ticks.
+    uint8_t ndelays = (mode == 1) ? 2 : 3;
+    p->fine = 0;
+    p->jitter_ns = 0;
+    uint16_t worst = 0;
+    for (uint8_t k=0; k < 3; k++) {
+        uint16_t n = (uint16_t)vregister[4+k];
+        p->delay[k] = corrected_count(n);
+        if (k >= ndelays || n == 0) continue;
+        uint16_t j = JITTER_TICK_NS;
+        if (vregister[22] == 0 && n <= FINE_MAX_TICKS) {
+            uint16_t cycles = corrected_count((uint16_t)(n * 8));
+            if (cycles < 0xFFFF) {
+                p->delay[k] = cycles;
+                p->fine |= (uint8_t)(1 << k);
+                j = JITTER_FOSC_NS;
+            }
+        }
+        if (j > worst) worst = j;
+    }
+    //
+    // Extrapolated events, in TOF mode only.
+    // Event3 has CCP2 on Timer1, Event4 and Event5 have TU16A and TU16B,
+    // counting from Event1 with the TOF, so they cannot also be delays.
+    p->ev_mult[0] = (uint8_t)(vregister[23] ? vregister[23] : 68);
+    p->ev_mult[1] = (uint8_t)vregister[24];
+    p->ev_mult[2] = (uint8_t)vregister[27];
+    p->ev_offset[0] = p->delay[2];
+    p->ev_offset[1] = corrected_count((uint16_t)vregister[25]);
+    p->ev_offset[2] = corrected_count((uint16_t)vregister[28]);
+    uint8_t ev4_mask = (uint8_t)vregister[26];
+    uint8_t ev5_mask = (uint8_t)vregister[29];
+    p->ev_fault = 0;
+    if (mode != 1) {
+        p->ev_mult[1] = 0;
+        p->ev_mult[2] = 0;
+    } else {
+        if (p->ev_mult[1] && (p->delay[0] || (ev4_mask & ~0x09))) p->ev_fault = 1;
+        if (p->ev_mult[2] && (p->delay[1] || (ev5_mask & 0x09))) p->ev_fault = 1;
+        for (uint8_t k=0; k < 3; k++) {
+            if (p->ev_mult[k] == 0) continue;
+            // The TOF may be a tick short, and the compare adds a tick.
+            uint16_t j = (uint16_t)p->ev_mult[k] * JITTER_TICK_NS / 16 + JITTER_TICK_NS;
+            if (j > p->jitter_ns) p->jitter_ns = j;
+        }
+    }
+    p->jitter_ns += worst;
+    uint16_t delay0 = p->delay[0];
+    uint16_t delay1 = p->delay[1];
+    uint16_t delay2 = p->delay[2];
+    //
+    // A pulse train starts with the event (Event3 in TOF mode),
+    // or when a delay runs out.
+    p->pulse_mask = (uint8_t)vregister[11];
+    p->pulse_start = (mode == 1) ? 0x18 : 0x20; // CCP2_OUT or CMP1_OUT
+    if (vregister[15] == 1 && delay0) p->pulse_start = 0x36; // TU16A_OUT
+    if (vregister[15] == 2 && delay1) p->pulse_start = 0x37; // TU16B_OUT
+    p->pulse_fault = plan_pulse_train(p);
+    //
+    // Connect the output of CLCs to the relevant output pins.
+    // Table 23-2 in data sheet.
+    uint8_t* src = p->pps;
+    if (mode == 1) {
+        // CLC5 can reach ports A,C
+        // CLC7 can reach ports B,D
+        src[0] = (delay0 == 0) ? 0x05 : 0x01; // OUT0 from CLC5 for Event3, or TU16A latched by CLC1
+        src[1] = (delay1 == 0) ? 0x07 : 0x08; // OUT1 from CLC7 for Event3, or TU16B latched by CLC8
+        src[2] = 0x07; // OUT2 Event3
+        src[3] = 0x05; // OUT3 Event3
+        src[4] = 0x07; // OUT4 Event3
+        src[5] = 0x07; // OUT5 Event3
+        src[6] = 0x04; // OUT6 Event2
+        src[7] = 0x03; // OUT7 Event1
+        // Event4 is latched by CLC1 (ports A,C), Event5 by CLC8 (ports B,D),
+        // and they take over the outputs selected by registers 26 and 29.
+        for (uint8_t k=0; k < 8; k++) {
+            uint8_t bit = (uint8_t)(1 << k);
+            if (p->ev_mult[1] && (ev4_mask & bit)) src[k] = 0x01;
+            if (p->ev_mult[2] && (ev5_mask & bit)) src[k] = 0x08;
+        }
+    } else {
+        // CLC1 can reach ports A,C
+        // CLC3 can reach ports B,D
+        src[0] = (delay0 == 0) ? 0x01 : 0x02; // OUT0 from CLC1, or TU16A latched by CLC2
+        src[1] = (delay1 == 0) ? 0x03 : 0x04; // OUT1 from CLC3, or TU16B latched by CLC4
+        src[2] = (delay2 == 0) ? 0x03 : 0x0D; // OUT2 from CLC3, or CCP1 (and TMR1)
+        src[3] = 0x01; // OUT3 from CLC1
+        src[4] = 0x03; // OUT4 to OUT7 from CLC3
+        src[5] = 0x03;
+        src[6] = 0x03;
+        src[7] = 0x03;
+    }
+    apply_pulse_outputs(src);
+} // end arm_plan_compile()
+
+// For comparison, 'P live' has the trigger functions recompile the plan
+// and set up the FVR, DACs and op-amps afresh at each arm,
+// and wait out each stage of the set-up before the next,
+// which is what arming did before there was a plan.
+uint8_t arm_plan_live = 0;
+#define ARM_SETTLE_MS 1
+
+void arm_plan_apply_analog()
+{
+    // The FVR and the op-amps are left alone if they are already as planned,
+    // so that arming need not wait for FVR RDY or for the op-amps to settle.
+    PROBE_BEGIN(PROBE_ARM_ANALOG);
+    if (arm_plan_live) {
+        arm_plan_compile();
+        update_FVRs();
+        update_DACs();
+        update_PGAs();
+    }
+    if (!FVRCONbits.EN || !FVRCONbits.RDY ||
+        FVRCONbits.ADFVR != arm_plan.fvr_gain || FVRCONbits.CDAFVR != arm_plan.fvr_gain) {
+        update_FVRs();
+    }
+    if (!DAC2CONbits.EN || !DAC3CONbits.EN) update_DACs();
+    DAC2DATL = arm_plan.dac[0];
+    DAC3DATL = arm_plan.dac[1];
+    uint8_t gsel = arm_plan.opa_gsel;
+    if (gsel == PLAN_NO_OPA) {
+        if (OPA1CON0bits.EN || OPA2CON0bits.EN) update_PGAs();
+    } else if (!OPA1CON0bits.EN || !OPA2CON0bits.EN ||
+               OPA1CON1bits.GSEL != gsel || OPA2CON1bits.GSEL != gsel) {
+        update_PGAs();
+    }
+    PROBE_END(PROBE_ARM_ANALOG);
+}
+
+void arm_stage_settle()
+{
+    // In the live path, let each stage of the set-up settle before the next.
+    // Otherwise, the trigger functions wait once, after the last stage,
+    // and then check everything together.
+    if (arm_plan_live) __delay_ms(ARM_SETTLE_MS);
+}
+
+void reply_arm_plan()
+{
+    putstr("plan mode=");
+    reply_uint(arm_plan.mode);
+    putstr(" fvr=");
+    reply_uint(arm_plan.fvr_gain);
+    putstr(" dac=");
+    reply_uint(arm_plan.dac[0]);
+    putch(',');
+    reply_uint(arm_plan.dac[1]);
+    putstr(" gsel=");
+    if (arm_plan.opa_gsel == PLAN_NO_OPA) {
+        putstr("off");
+    } else {
+        reply_uint(arm_plan.opa_gsel);
+    }
+    putstr(" cm-nch=");
+    reply_uint(arm_plan.cm_nch[0]);
+    putch(',');
+    reply_uint(arm_plan.cm_nch[1]);
+    putstr(" delays=");
+    for (uint8_t k=0; k < 3; k++) {
+        if (k) putch(',');
+        reply_uint(arm_plan.delay[k]);
+    }
+    putstr(" fine=");
+    reply_uint(arm_plan.fine);
+    putstr(" jitter-ns=");
+    reply_uint(arm_plan.jitter_ns);
+    putstr(" ev-mult=");
+    for (uint8_t k=0; k < 3; k++) {
+        if (k) putch(',');
+        reply_uint(arm_plan.ev_mult[k]);
+    }
+    putstr(" ev-offset=");
+    for (uint8_t k=0; k < 3; k++) {
+        if (k) putch(',');
+        reply_uint(arm_plan.ev_offset[k]);
+    }
+    if (arm_plan.ev_fault) putstr(" ev=unfit");
+    putstr(" pulse=");
+    if (arm_plan.pulse_mask == 0) {
+        putstr("none");
+    } else if (arm_plan.pulse_fault) {
+        putstr("unfit");
+    } else {
+        reply_hex(arm_plan.pulse_start, 2);
+        putstr(" pwm-pr=");
+        reply_uint(arm_plan.pwm_pr);
+        putstr(" pwm-p1=");
+        reply_uint(arm_plan.pwm_p1);
+        putstr(" tmr3=");
+        reply_hex(arm_plan.tmr3, 4);
+    }
+    putstr(" pps=");
+    for (uint8_t k=0; k < 8; k++) {
+        if (k) putch(',');
+        reply_hex(arm_plan.pps[k], 2);
+    }
+    putstr(arm_plan_live ? " path=live" : " path=plan");
+    putstr(" ok\n");
+}
+
+// Results of the most recent TOF trigger, in 125ns ticks.
+uint16_t last_tof = 0;
+uint16_t last_pr_value = 0;
+uint16_t last_ev_value[2]; // Event4 and Event5, 0 if not wanted
+uint8_t last_late = 0; // bit 0 for Event3, 1 for Event4, 2 for Event5
+
+uint16_t extrapolate(uint16_t tof, uint8_t mult, uint16_t offset)
+{
+    // mult/16 times the TOF, plus the offset, in ticks after Event1,
+    // held at the end of the 16-bit count if it would be beyond it.
+    // This is worked out after Event2, so it is kept to two byte-by-byte
+    // products and no loops, taking the same time whatever the values.
+    uint32_t t = (uint16_t)((uint16_t)(uint8_t)tof * mult)
+        + ((uint32_t)((uint16_t)(uint8_t)(tof >> 8) * mult) << 8);
+    t = (t >> 4) + offset;
+    return (t > 0xFFFF) ? 0xFFFF : (uint16_t)t;
+}
+
+// Shot bookkeeping for the status record.
+uint8_t armed_now = 0; // between announce_armed() and the outcome
+uint8_t last_flag = 0xFF; // 0xFF until the first shot
+uint16_t shot_count = 0; // since reset, wrapping
+
+void timer0_start(uint8_t ckps)
+{
+    // Timer0 as a 16-bit stopwatch, counting FOSC/4 with a prescale of 2^ckps.
+    T0CON0bits.EN = 0;
+    T0CON0bits.MD16 = 1;
+    T0CON1bits.CS = 0b010; // FOSC/4
+    T0CON1bits.ASYNC = 0;
+    T0CON1bits.CKPS = ckps;
+    TMR0H = 0;
+    TMR0L = 0;
+    T0CON0bits.EN = 1;
+}
+
+uint16_t timer0_ticks(void)
+{
+    uint8_t low = TMR0L; // reading TMR0L latches TMR0H
+    return (uint16_t)((TMR0H << 8) | low);
+}
+
+// Uptime, counted by Timer2 in 4.096ms ticks (MFINTOSC 31.25kHz, 1:128).
+// We run without interrupts, so the 8-bit count is extended in software
+// and uptime_service() must be called at least once per roll-over (1.05s).
+// The main loop and the long wait loops do so, and uart.c calls it
+// through uptime_wait_hook() while it waits to send or receive.
+// The 32-bit count wraps after 203 days.
+#define UPTIME_TICK_US 4096
+uint32_t uptime_high = 0; // whole roll-overs, in ticks
+uint8_t uptime_last = 0;
+
+void uptime_start(uint32_t ticks)
+{
+    // See Section 24 Timer2 in the data sheet; CS from the T2CLKCON table.
+    T2CONbits.ON = 0;
+    T2CLKCONbits.CS = 0b0110; // MFINTOSC 31.25kHz
+    T2HLTbits.PSYNC = 1; // synchronized to FOSC/4, so that reads are clean
+    T2HLTbits.MODE = 0b00000; // free running, software gate
+    T2CONbits.CKPS = 0b111; // 1:128
+    T2CONbits.OUTPS = 0b0000; // 1:1
+    T2PR = 255;
+    T2TMR = (uint8_t)(ticks & 0xFF);
+    uptime_high = ticks & 0xFFFFFF00UL;
+    uptime_last = T2TMR;
+    T2CONbits.ON = 1;
+}
+
+uint8_t uptime_service(void)
+// Returns 1 if the count has moved since the last call.
+{
+    PROFILE_SERVICE();
+    uint8_t t = T2TMR;
+    if (t == uptime_last) return 0;
+    if (t < uptime_last) uptime_high += 256;
+    uptime_last = t;
+    return 1;
+}
+
+void uptime_wait_hook(void)
+{
+    uptime_service();
+}
+
+uint32_t uptime_ticks(void)
+{
+    uptime_service();
+    return uptime_high + uptime_last;
+}
+
+// The trigger functions tell the PC that they are armed
+// only once the outputs are routed and the set-up checks have passed.
+// What they say depends on what asked for the arming.
+#define ARM_REPLY_NONE 0  // binary protocol, which replies at the end
+#define ARM_REPLY_TEXT 1  // 'a', the reply line is completed after the event
+#define ARM_REPLY_EARLY 2 // 'A', a short acknowledgement and nothing after the event
+uint8_t arm_reply_style = ARM_REPLY_NONE;
+uint8_t arm_announced = 0;
+uint8_t arm_ack_pending = 0;
+uint32_t arm_latency_us = 0;
+uint8_t broadcast_command = 0; // set while acting on an @* line
+
+// After a broadcast 'A', the nodes acknowledge in turn, so as not to
+// talk over each other on the bus. Node n starts n slots after an allowance
+// for the set-up, timed from when the node took the command line,
+// which is practically the same moment for all nodes.
+// The set-up takes about 1ms, or 1ms per stage, six at most, with 'P live'.
+// A slot is long enough for a 25-character acknowledgement plus a guard.
+// Timer0 ticks are 16us, so the schedule may run to 1.05s.
+#define ARM_SETUP_ALLOWANCE_US 10000
+#define ARM_TIMER_CKPS 0b1000 // 1:256
+#define ARM_TIMER_TICK_US 16
+
+uint8_t arm_slot_due(void)
+{
+    if (!broadcast_command) return 1;
+    uint32_t slot_us = 250000000L / selected_baud_rate() + 200;
+    uint32_t due_us = ARM_SETUP_ALLOWANCE_US + (uint32_t)vregister[8] * slot_us;
+    return (uint32_t)timer0_ticks() * ARM_TIMER_TICK_US >= due_us;
+}
+
+void begin_arm_reply(void)
+{
+    // The start of the reply, sent when the hardware is armed
+    // or has failed to arm.
+    if (arm_reply_style == ARM_REPLY_TEXT) {
+        if (vregister[0] == 0) {
+            putstr("Armed simple trigger, using INa only: ");
+        } else if (vregister[0] == 1) {
+            putstr("Armed time-of-flight trigger, using INa followed by INb: ");
+        }
+    } else if (arm_reply_style == ARM_REPLY_EARLY && broadcast_command) {
+        // Speak in our own slot and say who we are.
+        while (!arm_slot_due()) { uptime_service(); CLRWDT(); }
+        uart1_mute(0);
+        putch('@');
+        reply_uint((uint16_t)vregister[8]);
+        putch(' ');
+    }
+}
+
+void send_arm_ack(void)
+{
+    arm_ack_pending = 0;
+    begin_arm_reply();
+    putstr("armed ");
+    reply_ulong(arm_latency_us);
+    putstr(" ok\n");
+    uart1_mute(1); // The outcome is not reported.
+}
+
+void armed_status_service(void); // below, with the command interpreter
+
+void armed_wait(void)
+{
+    // Called from the loops waiting for the event.
+    // The acknowledgement goes out when its slot comes,
+    // without holding up the trigger functions.
+    // Once it has gone, status queries are answered, once per uptime tick.
+    // Replies queued meanwhile go out a DMA block at a time,
+    // so the next block is started on every pass.
+    // Incoming lines are assembled as they come, so that the receive ring
+    // does not overrun however long we wait; in the binary protocol,
+    // the bytes are left for the frame parser, but still watched.
+    CLRWDT();
+    if (arm_reply_style == ARM_REPLY_NONE) {
+        uart1_rx_check();
+    } else {
+        uart1_rx_service();
+    }
+    uart1_tx_service();
+    if (arm_ack_pending && arm_slot_due()) send_arm_ack();
+    if (uptime_service() && arm_reply_style == ARM_REPLY_EARLY && !arm_ack_pending) {
+        armed_status_service();
+    }
+}
+
+void announce_armed(void)
+{
+    // Called by the trigger functions just before waiting for the event.
+    arm_latency_us = (uint32_t)timer0_ticks() * ARM_TIMER_TICK_US;
+    armed_now = 1;
+    if (arm_reply_style == ARM_REPLY_NONE) return;
+    arm_announced = 1;
+    if (arm_reply_style == ARM_REPLY_EARLY) {
+        arm_ack_pending = 1;
+        armed_wait();
+    } else {
+        begin_arm_reply();
+    }
+}
+
+// Baseline tracking of the trigger levels, registers 16 to 18.
+// While armed, and until the event, the ADC samples INa and INb in turn
+// and the DAC codes are moved towards a constant margin above
+// the smoothed baselines, by no more than the step size per update.
+// Conversions are started and collected without waiting for them,
+// so the wait loops stay quick, and the comparators and latches
+// are left alone, so the path from the inputs to the outputs
+// stays in hardware.
+// The ADC and the DACs share the FVR, so one DAC count is 16 ADC counts.
+uint16_t track_baseline8[2]; // 8 times the smoothed ADC count
+uint8_t track_k = 0; // input being converted, or next to be
+uint8_t track_busy = 0;
+uint16_t track_due = 0; // Timer0 ticks
+
+uint8_t track_level(uint8_t k)
+{
+    int16_t code = (int16_t)(track_baseline8[k] >> 7) + vregister[16];
+    return (code > 255) ? 255 : (uint8_t)code;
+}
+
+void set_DAC_level(uint8_t k, uint8_t code)
+{
+    if (k == 0) {
+        DAC2DATL = code;
+    } else {
+        DAC3DATL = code;
+    }
+}
+
+void track_start()
+{
+    // At set-up, before the comparators are checked:
+    // take the baselines as they are and put the levels straight there.
+    if (vregister[16] <= 0) return;
+    for (uint8_t k=0; k < 2; ++k) {
+        track_baseline8[k] = ADC_read(comparator_adc_channel(k)) << 3;
+        set_DAC_level(k, track_level(k));
+    }
+    track_k = 0;
+    track_busy = 0;
+    track_due = timer0_ticks();
+}
+
+void track_baselines(uint8_t inputs)
+{
+    // Called from the wait loops; inputs has bit 0 set to keep tracking INa
+    // and bit 1 for INb. Their levels are held once the event has come.
+    if (vregister[16] <= 0) return;
+    if (track_busy) {
+        if (ADCON0bits.GO) return;
+        track_busy = 0;
+        PIR1bits.ADIF = 0;
+        uint8_t k = track_k;
+        track_baseline8[k] += ADRES - (track_baseline8[k] >> 3);
+        if (inputs & (1 << k)) {
+            uint8_t target = track_level(k);
+            uint8_t code = (k == 0) ? DAC2DATL : DAC3DATL;
+            uint8_t step = (vregister[17] > 0) ? (uint8_t)vregister[17] : 1;
+            if (target > code) {
+                code = (target - code > step) ? code + step : target;
+            } else if (target < code) {
+                code = (code - target > step) ? code - step : target;
+            }
+            set_DAC_level(k, code);
+        }
+        track_k ^= 1;
+        if (track_k == 0) {
+            int16_t ms = vregister[18];
+            if (ms < 1) ms = 1;
+            if (ms > 1000) ms = 1000;
+            track_due += (uint16_t)(((uint32_t)ms * 1000) / ARM_TIMER_TICK_US);
+        }
+        return;
+    }
+    if (track_k == 0 && (int16_t)(timer0_ticks() - track_due) < 0) return;
+    ADPCH = comparator_adc_channel(track_k);
+    ADCON0bits.GO = 1;
+    track_busy = 1;
+}
+
 uint8_t trigger_simple()
 {
     // Set up comparator 1 to monitor the analog input INa
@@ -282,14 +1421,20 @@ uint8_t trigger_simple()
     // 2 the delay timer TU16A started prematurely
     // 3 the delay timer TU16B started prematurely
     // 4 the delay time TMR1/CCP1 is high too soon
+    // 5 the output routing could not be verified
+    // 6 the pulse train settings do not fit
+    // 7 VDD is outside the window of registers 20 and 21
     //
-    update_FVRs();
-    update_DACs();
+    PROBE_BEGIN(PROBE_SIMPLE_SETUP);
+    if (!supply_in_window()) return 7;
+    if (arm_plan.pulse_fault) return 6; // before touching the hardware
+    arm_plan_apply_analog();
+    track_start();
     // Connect INa through comparator 1.
     // Our external signal goes into the inverting input of the comparator,
     // so we need to invert the polarity to get trigger on positive slope
     // of the external signal.
-    CM1NCH = 0b000; // C1IN0- pin
+    CM1NCH = arm_plan.cm_nch[0]; // C1IN0- pin or OPA1_OUT
     CM1PCH = 0b100; // DAC2_Output
     CM1CON0bits.POL = 1;
     CM1CON0bits.HYS = 0; // no hysteresis
@@ -297,11 +1442,7 @@ uint8_t trigger_simple()
     CM1CON0bits.EN = 1;
     // The signal out of the comparator should transition 0 to 1
     // as the external trigger voltage crosses the specified level.
-    __delay_ms(1);
-    if (CMOUTbits.MC1OUT) {
-        // Fail early because the comparator is already triggered.
-        return 1;
-    }
+    arm_stage_settle();
     // The use of two CLCs gets us access to all ports for the output pins.
     // Table 23-2 in data sheet states that:
     //   CLC1 can reach ports A,C
@@ -311,16 +1452,16 @@ uint8_t trigger_simple()
     setup_CLCn_as_latch(3, 0x20); // CLC3 latches CMP1_OUT also
     //
     // Some out the outputs may be delayed so set up timers.
-    uint16_t delay0 = (uint16_t)vregister[4];
-    uint16_t delay1 = (uint16_t)vregister[5];
-    uint16_t delay2 = (uint16_t)vregister[6];
+    uint16_t delay0 = arm_plan.delay[0];
+    uint16_t delay1 = arm_plan.delay[1];
+    uint16_t delay2 = arm_plan.delay[2];
     //
     TUCHAINbits.CH16AB = 0; // independent counters
     if (delay0) {
         // OUT0 is delayed; use universal timer A started by CLC1_OUT.
         TU16ACON0bits.ON = 0;
         TU16ACLK = 0b00010; // FOSC
-        TU16APS = 7; // With FOSC=64MHz, we want 125ns ticks
+        TU16APS = (arm_plan.fine & 0x01) ? 0 : 7; // FOSC cycles, or 125ns ticks
         TU16AHLTbits.CSYNC = 1;
         TU16ACON1bits.OSEN = 0; // not one shot
         TU16ACON0bits.OM = 0; // pulse mode output
@@ -334,17 +1475,13 @@ uint8_t trigger_simple()
         // Use CLC2 as an SR latch on this output.
         setup_CLCn_as_latch(2, 0x36);
         TU16ACON0bits.ON = 1;
-        __delay_ms(1);
-        if (TU16ACON1bits.RUN) {
-            // Fail early because the counter has started prematurely.
-            return 2;
-        }
+        arm_stage_settle();
     }
     if (delay1) {
         // OUT1 is delayed; use universal timer B started by CLC1_OUT.
         TU16BCON0bits.ON = 0;
         TU16BCLK = 0b00010; // FOSC
-        TU16BPS = 7; // With FOSC=64MHz, we want 125ns ticks
+        TU16BPS = (arm_plan.fine & 0x02) ? 0 : 7; // FOSC cycles, or 125ns ticks
         TU16BHLTbits.CSYNC = 1;
         TU16BCON1bits.OSEN = 0; // not one shot
         TU16BCON0bits.OM = 0; // pulse mode output
@@ -358,17 +1495,18 @@ uint8_t trigger_simple()
         // Use CLC4 as an SR latch on this output.
         setup_CLCn_as_latch(4, 0x37);
         TU16BCON0bits.ON = 1;
-        __delay_ms(1);
-        if (TU16BCON1bits.RUN) {
-            // Fail early because the counter has started prematurely.
-            return 3;
-        }
+        arm_stage_settle();
     }
     if (delay2) {
         // OUT2 is delayed; use Timer1 gated by CLC1_OUT.
         T1CONbits.ON = 0;
-        T1CLKbits.CS = 0b00001; // FOSC/4
-        T1CONbits.CKPS = 0b01; // prescale 1:2 to get 125ns ticks
+        if (arm_plan.fine & 0x04) {
+            T1CLKbits.CS = 0b00010; // FOSC
+            T1CONbits.CKPS = 0b00; // no prescale
+        } else {
+            T1CLKbits.CS = 0b00001; // FOSC/4
+            T1CONbits.CKPS = 0b01; // prescale 1:2 to get 125ns ticks
+        }
         T1CONbits.RD16 = 1;
         T1GATEbits.GSS = 0b10010; // CLC1_OUT
         T1GCONbits.GPOL = 1; // timer gate is active high
@@ -384,69 +1522,51 @@ uint8_t trigger_simple()
         NOP(); NOP();
         CCP1CONbits.EN = 1;
         T1CONbits.ON = 1; // enable count
-        __delay_ms(1);
-        if (CCP1CONbits.OUT) {
-            // Fail early because the TMR1/CCP1 is already showing high.
-            return 4;
-        }
+        arm_stage_settle();
     }
     //
-    // Connect the output of CLCs to the relevant output pins.
-    GIE = 0; // We run without interrupt.
-    PPSLOCK = 0x55;
-    PPSLOCK = 0xaa;
-    PPSLOCKED = 0;
-    // Table 23-2 in data sheet.
-    // CLC1 can reach ports A,C
-    // CLC3 can reach ports B,D
-    if (delay0 == 0) {
-        RC2PPS = 0x01; // OUT0a from CLC1
-        RC3PPS = 0x01; // OUT0b
-    } else {
-        RC2PPS = 0x02; // OUT0a from TU16A latched by CLC2
-        RC3PPS = 0x02; // OUT0b
-    }
-    if (delay1 == 0) {
-        RD0PPS = 0x03; // OUT1a from CLC3
-        RD1PPS = 0x03; // OUT1b
-    } else {
-        RD0PPS = 0x04; // OUT1a from TU16B latched by CLC4
-        RD1PPS = 0x04; // OUT1b
+    // Nothing should have happened yet; fail early if it has.
+    if (!arm_plan_live) __delay_ms(ARM_SETTLE_MS);
+    if (CMOUTbits.MC1OUT) return 1; // the comparator is already triggered
+    if (delay0 && TU16ACON1bits.RUN) return 2; // the counter started prematurely
+    if (delay1 && TU16BCON1bits.RUN) return 3;
+    if (delay2 && CCP1CONbits.OUT) return 4; // TMR1/CCP1 already showing high
+    //
+    setup_pulse_train();
+    if (route_outputs(arm_plan.pps)) {
+        route_outputs(no_outputs);
+        close_pulse_train();
+        return 5;
     }
-    if (delay2 == 0) {
-        RD2PPS = 0x03; // OUT2a
-        RD3PPS = 0x03; // OUT2b
-    } else {
-        RD2PPS = 0x0D; // OUT2a from CCP1 (and TMR1)
-        RD3PPS = 0x0D; // OUT2b
-    }
-    RC4PPS = 0x01; // OUT3a
-    RC5PPS = 0x01; // OUT3b
-    RD4PPS = 0x03; // OUT4a
-    RD5PPS = 0x03; // OUT4b
-    RD6PPS = 0x03; // OUT5a
-    RD7PPS = 0x03; // OUT5b
-    RB2PPS = 0x03; // OUT6a
-    RB3PPS = 0x03; // OUT6b
-    RB4PPS = 0x03; // OUT7a
-    RB5PPS = 0x03; // OUT7b
-    PPSLOCK = 0x55;
-    PPSLOCK = 0xaa;
-    PPSLOCKED = 1;
+    //
+    // Only now may the event reach the outputs.
+    // Enable the latches on the timer outputs first and then,
+    // back to back, the two that latch the comparator,
+    // so that an event arriving now is seen by both or neither.
+    if (delay0) enable_CLCn(2);
+    if (delay1) enable_CLCn(4);
+    if (arm_plan.pulse_mask) enable_CLCn(6);
+    enable_CLCn(1);
+    enable_CLCn(3);
     //
     LED1 = 1; // Indicate that we are armed and waiting.
     LED2 = 1; // Second LED indicator.
+    PROBE_END(PROBE_SIMPLE_SETUP);
+    announce_armed();
     //
     // Wait until the event and then clean up.
-    while (!CMOUTbits.MC1OUT) { CLRWDT(); }
-    while (!CLCDATAbits.CLC1OUT) { CLRWDT(); }
-    while (!CLCDATAbits.CLC3OUT) { CLRWDT(); }
-    while (!PORTCbits.RC4) { CLRWDT(); }  // OUT3 on CLC1
-    while (!PORTDbits.RD4) { CLRWDT(); }  // OUT4 on CLC3
+    while (!CMOUTbits.MC1OUT) { armed_wait(); track_baselines(0b01); }
+    while (!CLCDATAbits.CLC1OUT) { armed_wait(); }
+    while (!CLCDATAbits.CLC3OUT) { armed_wait(); }
+    // Outputs carrying a pulse train are not steady, so are not waited for;
+    // the train is over well within the hold time below.
+    uint8_t pulsed = arm_plan.pulse_mask;
+    while (!PORTCbits.RC4 && !(pulsed & 0x08)) { armed_wait(); }  // OUT3 on CLC1
+    while (!PORTDbits.RD4 && !(pulsed & 0x10)) { armed_wait(); }  // OUT4 on CLC3
     // The delayed outputs may happen later, so wait for those, too.
-    while (!PORTCbits.RC2) { CLRWDT(); }  // OUT0
-    while (!PORTDbits.RD0) { CLRWDT(); }  // OUT1
-    while (!PORTDbits.RD2) { CLRWDT(); }  // OUT2
+    while (!PORTCbits.RC2 && !(pulsed & 0x01)) { armed_wait(); }  // OUT0
+    while (!PORTDbits.RD0 && !(pulsed & 0x02)) { armed_wait(); }  // OUT1
+    while (!PORTDbits.RD2 && !(pulsed & 0x04)) { armed_wait(); }  // OUT2
     //
     // After the event, keep the outputs high for a short while
     // and then clean up.
@@ -455,21 +1575,7 @@ uint8_t trigger_simple()
     LED2 = 0;
     //
     // Redirect the output pins to their latches (which are all low).
-    GIE = 0; // We run without interrupt.
-    PPSLOCK = 0x55;
-    PPSLOCK = 0xaa;
-    PPSLOCKED = 0;
-    RC2PPS = 0x00; RC3PPS = 0x00; // OUT0
-    RD0PPS = 0x00; RD1PPS = 0x00; // OUT1
-    RD2PPS = 0x00; RD3PPS = 0x00; // OUT2
-    RC4PPS = 0x00; RC5PPS = 0x00; // OUT3
-    RD4PPS = 0x00; RD5PPS = 0x00; // OUT4
-    RD6PPS = 0x00; RD7PPS = 0x00; // OUT5
-    RB2PPS = 0x00; RB3PPS = 0x00; // OUT6
-    RB4PPS = 0x00; RB5PPS = 0x00; // OUT7b
-    PPSLOCK = 0x55;
-    PPSLOCK = 0xaa;
-    PPSLOCKED = 1;
+    route_outputs(no_outputs);
     //
     // Cleanup and disable peripherals.
     for (uint8_t i=0; i < 4; i++) {
@@ -481,6 +1587,7 @@ uint8_t trigger_simple()
     T1CONbits.ON = 0;
     CCP1CONbits.EN = 0;
     CM1CON0bits.EN = 0;
+    close_pulse_train();
     //
     return 0; // Success is presumed at this point.
 } // end trigger_simple()
@@ -495,6 +1602,8 @@ uint8_t trigger_TOF()
     // Compute the estimated time of arrival at test section (Event3)
     // and use Timer3+CCP2 to generate Event3.
     // Event3 drives the immediate outputs and starts the fixed delay timers.
+    // Event4 and Event5, if wanted, are extrapolated in the same way,
+    // for other stations, with TU16A and TU16B counting from Event1.
     //
     // Returns:
     // 0 if successfully set up and the event passes,
@@ -504,14 +1613,22 @@ uint8_t trigger_TOF()
     // 4 if CCP2 compare already happened at set-up time.
     // 5 the delay timer TU16A started prematurely
     // 6 the delay timer TU16B started prematurely
+    // 7 the output routing could not be verified
+    // 8 the pulse train settings do not fit
+    // 9 VDD is outside the window of registers 20 and 21
+    // 10 Event4 or Event5 clashes with a delay or cannot reach its outputs
     //
-    update_FVRs();
-    update_DACs();
+    PROBE_BEGIN(PROBE_TOF_SETUP);
+    if (!supply_in_window()) return 9;
+    if (arm_plan.pulse_fault) return 8; // before touching the hardware
+    if (arm_plan.ev_fault) return 10;
+    arm_plan_apply_analog();
+    track_start();
     // Connect INa through comparator 1 to generate Event1.
     // Our external signal goes into the inverting input of the comparator,
     // so we need to invert the polarity to get trigger on positive slope
     // of the external signal.
-    CM1NCH = 0b000; // C1IN0- pin
+    CM1NCH = arm_plan.cm_nch[0]; // C1IN0- pin or OPA1_OUT
     CM1PCH = 0b100; // DAC2_Output
     CM1CON0bits.POL = 1;
     CM1CON0bits.HYS = 0; // no hysteresis
@@ -519,11 +1636,7 @@ uint8_t trigger_TOF()
     CM1CON0bits.EN = 1;
     // The signal out of the comparator should transition 0 to 1
     // as the external trigger voltage crosses the specified level.
-    __delay_ms(1);
-    if (CMOUTbits.MC1OUT) {
-        // Fail early because the comparator is already triggered.
-        return 1;
-    }
+    arm_stage_settle();
     // For Event1, use CLC3 for the output pins on PortB.
     // Table 23-2 in data sheet states that:
     //   CLC1,2 can reach ports A,C
@@ -536,7 +1649,7 @@ uint8_t trigger_TOF()
     // Our external signal goes into the inverting input of the comparator,
     // so we need to invert the polarity to get trigger on positive slope
     // of the external signal.
-    CM2NCH = 0b011; // C1IN3- pin
+    CM2NCH = arm_plan.cm_nch[1]; // C2IN3- pin or OPA2_OUT
     CM2PCH = 0b101; // DAC3_Output
     CM2CON0bits.POL = 1;
     CM2CON0bits.HYS = 0; // no hysteresis
@@ -544,11 +1657,7 @@ uint8_t trigger_TOF()
     CM2CON0bits.EN = 1;
     // The signal out of the comparator should transition 0 to 1
     // as the external trigger voltage crosses the specified level.
-    __delay_ms(1);
-    if (CMOUTbits.MC2OUT) {
-        // Fail early because the comparator is already triggered.
-        return 2;
-    }
+    arm_stage_settle();
     setup_CLCn_as_latch(4, 0x21); // CLC4 to latch CMP2_OUT for Event2.
     //
     // Set up TMR1+CCP1 to capture the TOF period, following Event1
@@ -571,11 +1680,7 @@ uint8_t trigger_TOF()
     NOP(); NOP();
     CCP1CONbits.EN = 1; // enable capture
     T1CONbits.ON = 1; // enable count
-    __delay_ms(1);
-    if (PIR3bits.CCP1IF) {
-        // Fail early because capture has already happened.
-        return 3;
-    }
+    arm_stage_settle();
     //
     // Event3 will be generated after a delay following Event2
     // This delay is computed from the TOF period between Events 1 and 2.
@@ -589,11 +1694,7 @@ uint8_t trigger_TOF()
     PIR8bits.CCP2IF = 0; // clear after changing mode
     // Note that we do not know yet the actual count for the computed delay.
     CCP2CONbits.EN = 0; // clear the output
-    __delay_ms(1);
-    if (PIR8bits.CCP2IF) {
-        // Fail early because compare has already happened.
-        return 4;
-    }
+    arm_stage_settle();
     //
     // Latch the output of CCP2 with CLC5 and CLC7
     // so that we can feed IO pins on all of the ports.
@@ -601,15 +1702,15 @@ uint8_t trigger_TOF()
     setup_CLCn_as_latch(7, 0x18);
     //
     // Some out the outputs may be delayed so set up timers.
-    uint16_t delay0 = (uint16_t)vregister[4];
-    uint16_t delay1 = (uint16_t)vregister[5];
+    uint16_t delay0 = arm_plan.delay[0];
+    uint16_t delay1 = arm_plan.delay[1];
     //
     TUCHAINbits.CH16AB = 0; // independent counters
     if (delay0) {
         // OUT0 is delayed; use universal timer A started by CLC5_OUT.
         TU16ACON0bits.ON = 0;
         TU16ACLK = 0b00010; // FOSC
-        TU16APS = 7; // With FOSC=64MHz, we want 125ns ticks
+        TU16APS = (arm_plan.fine & 0x01) ? 0 : 7; // FOSC cycles, or 125ns ticks
         TU16AHLTbits.CSYNC = 1;
         TU16ACON1bits.OSEN = 0; // not one shot
         TU16ACON0bits.OM = 0; // pulse mode output
@@ -623,17 +1724,13 @@ uint8_t trigger_TOF()
         // Use CLC1 as an SR latch on TU16A output.
         setup_CLCn_as_latch(1, 0x36);
         TU16ACON0bits.ON = 1;
-        __delay_ms(1);
-        if (TU16ACON1bits.RUN) {
-            // Fail early because the counter has started prematurely.
-            return 5;
-        }
+        arm_stage_settle();
     }
     if (delay1) {
         // OUT1 is delayed; use universal timer B started by CLC5_OUT.
         TU16BCON0bits.ON = 0;
         TU16BCLK = 0b00010; // FOSC
-        TU16BPS = 7; // With FOSC=64MHz, we want 125ns ticks
+        TU16BPS = (arm_plan.fine & 0x02) ? 0 : 7; // FOSC cycles, or 125ns ticks
         TU16BHLTbits.CSYNC = 1;
         TU16BCON1bits.OSEN = 0; // not one shot
         TU16BCON0bits.OM = 0; // pulse mode output
@@ -647,97 +1744,142 @@ uint8_t trigger_TOF()
         // Use CLC8 as an SR latch on this output.
         setup_CLCn_as_latch(8, 0x37);
         TU16BCON0bits.ON = 1;
-        __delay_ms(1);
-        if (TU16BCON1bits.RUN) {
-            // Fail early because the counter has started prematurely.
-            return 6;
-        }
+        arm_stage_settle();
     }
     //
-    // Connect the output of CLCs to the relevant output pins.
-    GIE = 0; // We run without interrupt.
-    PPSLOCK = 0x55;
-    PPSLOCK = 0xaa;
-    PPSLOCKED = 0;
-    // Table 23-2 in data sheet.
-    // CLC5 can reach ports A,C
-    // CLC7 can reach ports B,D
-    if (delay0 == 0) {
-        RC2PPS = 0x05; // OUT0a from CLC5 for Event3
-        RC3PPS = 0x05; // OUT0b
-    } else {
-        RC2PPS = 0x01; // OUT0a from TU16A latched by CLC1
-        RC3PPS = 0x01; // OUT0b
+    // Event4 and Event5 count from Event1, as Timer1 does, and run on
+    // through PR match, so that an event whose count is passed before
+    // its PR is written comes late, after a roll-over, rather than never.
+    // Until then, PR is at the end of the count and the latches are
+    // left disabled, so that nothing fires if Event2 is very late.
+    uint8_t ev4 = arm_plan.ev_mult[1];
+    uint8_t ev5 = arm_plan.ev_mult[2];
+    if (ev4) {
+        TU16ACON0bits.ON = 0;
+        TU16ACLK = 0b00010; // FOSC
+        TU16APS = 7; // 125ns ticks, as Timer1
+        TU16AHLTbits.CSYNC = 1;
+        TU16ACON1bits.OSEN = 0; // not one shot
+        TU16ACON0bits.OM = 0; // pulse mode output
+        TU16AHLTbits.START = 0b10; // rising ERS edge
+        TU16AHLTbits.RESET = 0; // none
+        TU16AHLTbits.STOP = 0; // none
+        TU16AERS = 0b10000; // CLC3_OUT
+        TU16APR = 0xFFFF;
+        TU16ACON1bits.CLR = 1; // clear count
+        // Use CLC1 as an SR latch on TU16A output.
+        setup_CLCn_as_latch(1, 0x36);
+        TU16ACON0bits.ON = 1;
+        arm_stage_settle();
+    }
+    if (ev5) {
+        TU16BCON0bits.ON = 0;
+        TU16BCLK = 0b00010; // FOSC
+        TU16BPS = 7; // 125ns ticks, as Timer1
+        TU16BHLTbits.CSYNC = 1;
+        TU16BCON1bits.OSEN = 0; // not one shot
+        TU16BCON0bits.OM = 0; // pulse mode output
+        TU16BHLTbits.START = 0b10; // rising ERS edge
+        TU16BHLTbits.RESET = 0; // none
+        TU16BHLTbits.STOP = 0; // none
+        TU16BERS = 0b10000; // CLC3_OUT
+        TU16BPR = 0xFFFF;
+        TU16BCON1bits.CLR = 1; // clear count
+        // Use CLC8 as an SR latch on TU16B output.
+        setup_CLCn_as_latch(8, 0x37);
+        TU16BCON0bits.ON = 1;
+        arm_stage_settle();
     }
-    if (delay1 == 0) {
-        RD0PPS = 0x07; // OUT1a from CLC7 for Event3
-        RD1PPS = 0x07; // OUT1b
-    } else {
-        RD0PPS = 0x08; // OUT1a from TU16B latched by CLC8
-        RD1PPS = 0x08; // OUT1b
-    }
-    // Event3
-    RD2PPS = 0x07; // OUT2a
-    RD3PPS = 0x07; // OUT2b
-    RC4PPS = 0x05; // OUT3a
-    RC5PPS = 0x05; // OUT3b
-    RD4PPS = 0x07; // OUT4a
-    RD5PPS = 0x07; // OUT4b
-    RD6PPS = 0x07; // OUT5a
-    RD7PPS = 0x07; // OUT5b
-    // Event2
-    RB2PPS = 0x04; // OUT6a
-    RB3PPS = 0x04; // OUT6b
-    // Event1
-    RB4PPS = 0x03; // OUT7a
-    RB5PPS = 0x03; // OUT7b
-    PPSLOCK = 0x55;
-    PPSLOCK = 0xaa;
-    PPSLOCKED = 1;
+    //
+    // Nothing should have happened yet; fail early if it has.
+    if (!arm_plan_live) __delay_ms(ARM_SETTLE_MS);
+    if (CMOUTbits.MC1OUT) return 1; // the comparators are already triggered
+    if (CMOUTbits.MC2OUT) return 2;
+    if (PIR3bits.CCP1IF) return 3; // capture has already happened
+    if (PIR8bits.CCP2IF) return 4; // compare has already happened
+    if ((delay0 || ev4) && TU16ACON1bits.RUN) return 5; // the counters started prematurely
+    if ((delay1 || ev5) && TU16BCON1bits.RUN) return 6;
+    //
+    setup_pulse_train();
+    if (route_outputs(arm_plan.pps)) {
+        route_outputs(no_outputs);
+        close_pulse_train();
+        return 7;
+    }
+    //
+    // Enable the latches from the last in the chain of events
+    // to the first, so that Event1 is the last to become possible.
+    if (delay0) enable_CLCn(1);
+    if (delay1) enable_CLCn(8);
+    if (arm_plan.pulse_mask) enable_CLCn(6);
+    enable_CLCn(5);
+    enable_CLCn(7);
+    enable_CLCn(4);
+    enable_CLCn(3);
     //
     LED1 = 1; // Indicate that we are armed and waiting.
     LED2 = 1; // Second LED indicator.
+    PROBE_END(PROBE_TOF_SETUP);
+    announce_armed();
     //
     // Event3 will be generated after a delay computed from 
     // the TOF between Events 1 and 2.
-    uint16_t delay_extra = (uint16_t)vregister[6];
+    uint8_t ev3_mult = arm_plan.ev_mult[0];
+    uint16_t delay_extra = arm_plan.ev_offset[0];
     //
     // We cannot do anything more until Event2.
-    while (!CLCDATAbits.CLC4OUT) { CLRWDT(); }
+    // The levels track the baselines until Event1.
+    while (!CLCDATAbits.CLC4OUT) {
+        armed_wait();
+        track_baselines(CLCDATAbits.CLC3OUT ? 0 : 0b11);
+    }
     NOP(); NOP();
     uint16_t tof = CCPR1;
-    // For X2 AT4-AT7 sensors, set the delay to be 4.25 times the TOF period.
-    uint16_t pr_value = (tof << 2) + (tof >> 2) + delay_extra;
+    // For X2 AT4-AT7 sensors, set the delay to be 4.25 times the TOF period,
+    // register 23 being 0.
+    uint16_t pr_value = extrapolate(tof, ev3_mult, delay_extra);
     CCPR2 = pr_value;
     NOP(); NOP();
     CCP2CONbits.EN = 1;
+    uint16_t ev4_value = 0;
+    uint16_t ev5_value = 0;
+    if (ev4) {
+        ev4_value = extrapolate(tof, ev4, arm_plan.ev_offset[1]);
+        TU16APR = ev4_value ? ev4_value - 1 : 0;
+        enable_CLCn(1);
+    }
+    if (ev5) {
+        ev5_value = extrapolate(tof, ev5, arm_plan.ev_offset[2]);
+        TU16BPR = ev5_value ? ev5_value - 1 : 0;
+        enable_CLCn(8);
+    }
+    // Any event whose time had passed by now comes a roll-over late.
+    uint16_t now = TMR1;
+    last_late = 0;
+    if (now >= pr_value) last_late |= 0x01;
+    if (ev4 && now >= ev4_value) last_late |= 0x02;
+    if (ev5 && now >= ev5_value) last_late |= 0x04;
+    last_tof = tof;
+    last_pr_value = pr_value;
+    last_ev_value[0] = ev4_value;
+    last_ev_value[1] = ev5_value;
     //
-    // Wait until Event3.
-    while (!CLCDATAbits.CLC5OUT) { CLRWDT(); }
-    // The delayed outputs may happen later, so wait for those, too.
-    while (!PORTCbits.RC2) { CLRWDT(); }  // OUT0
-    while (!PORTDbits.RD0) { CLRWDT(); }  // OUT1
+    // Wait until Event3, and Event4 and Event5 if wanted.
+    while (!CLCDATAbits.CLC5OUT) { armed_wait(); }
+    while (ev4 && !CLCDATAbits.CLC1OUT) { armed_wait(); }
+    while (ev5 && !CLCDATAbits.CLC8OUT) { armed_wait(); }
+    // The delayed outputs may happen later, so wait for those, too,
+    // unless they carry a pulse train.
+    uint8_t pulsed = arm_plan.pulse_mask;
+    while (!PORTCbits.RC2 && !(pulsed & 0x01)) { armed_wait(); }  // OUT0
+    while (!PORTDbits.RD0 && !(pulsed & 0x02)) { armed_wait(); }  // OUT1
     //
     // After the event, keep the outputs high for a short while
     // and then clean up.
     __delay_ms(100);
     //
     // Redirect the output pins to their latches (which are all low).
-    GIE = 0; // We run without interrupt.
-    PPSLOCK = 0x55;
-    PPSLOCK = 0xaa;
-    PPSLOCKED = 0;
-    RC2PPS = 0x00; RC3PPS = 0x00; // OUT0
-    RD0PPS = 0x00; RD1PPS = 0x00; // OUT1
-    RD2PPS = 0x00; RD3PPS = 0x00; // OUT2
-    RC4PPS = 0x00; RC5PPS = 0x00; // OUT3
-    RD4PPS = 0x00; RD5PPS = 0x00; // OUT4
-    RD6PPS = 0x00; RD7PPS = 0x00; // OUT5
-    RB2PPS = 0x00; RB3PPS = 0x00; // OUT6
-    RB4PPS = 0x00; RB5PPS = 0x00; // OUT7b
-    PPSLOCK = 0x55;
-    PPSLOCK = 0xaa;
-    PPSLOCKED = 1;
+    route_outputs(no_outputs);
     //
     // Cleanup and disable peripherals.
     for (uint8_t i=0; i < 8; i++) {
@@ -747,27 +1889,447 @@ uint8_t trigger_TOF()
     TU16ACON0bits.ON = 0;
     TU16BCON0bits.ON = 0;
     T1CONbits.ON = 0;
-    T3CONbits.ON = 0;
+    close_pulse_train();
     CCP1CONbits.EN = 0;
     CCP2CONbits.EN = 0;
     CM1CON0bits.EN = 0;
     CM2CON0bits.EN = 0;
     //
-    // Some debug (but, maybe, we'll keep it)
-    printf("tof=%u pr=%d ", tof, pr_value);
     LED1 = 0; // No longer armed and waiting.
     LED2 = 0;
     return 0;
 }
 
-void arm_and_wait_for_event(void)
+// Outputs whose rising edges can be captured by CCP1 and CCP2.
+// Input PPS for the CCPs reaches ports B and C only (Table 23-1),
+// so OUT1, OUT2, OUT4 and OUT5 on port D are not measured,
+// but they are driven by CLC3, as are OUT6 and OUT7 on port B.
+#define NSKEW 4
+const uint8_t skew_outputs[NSKEW] = {0, 3, 6, 7};
+const uint8_t skew_pins[NSKEW] = {0x12, 0x14, 0x0A, 0x0C}; // RC2, RC4, RB2, RB4
+// Simple-trigger routing without delays: CLC1 to ports C, CLC3 to ports B, D.
+const uint8_t skew_routing[8] = {0x01, 0x03, 0x03, 0x01, 0x03, 0x03, 0x03, 0x03};
+int16_t skew_ticks[NSKEW]; // after OUT0, in 15.625ns ticks of FOSC
+
+uint8_t measure_output_skew()
+{
+    // Fire the outputs as a simple trigger without delays would,
+    // forcing the event by flipping the polarity of comparator 1,
+    // and capture the rising edges of OUT0 and one other output
+    // with Timer1 counting at FOSC. One shot per output measured.
+    // The outputs really do go high, briefly.
+    //
+    // Returns:
+    // 0 if all of the edges were captured,
+    // 1 if the comparator is already high at set-up time,
+    // 2 if the output routing could not be verified,
+    // 3 if an edge was not captured.
+    //
+    uint8_t flag = 0;
+    update_FVRs();
+    update_DACs();
+    update_PGAs();
+    skew_ticks[0] = 0;
+    for (uint8_t k=1; k < NSKEW && flag == 0; ++k) {
+        CM1NCH = cm1_input(); // C1IN0- pin or OPA1_OUT
+        CM1PCH = 0b100; // DAC2_Output
+        CM1CON0bits.POL = 1;
+        CM1CON0bits.HYS = 0;
+        CM1CON0bits.SYNC = 0;
+        CM1CON0bits.EN = 1;
+        __delay_ms(1);
+        if (CMOUTbits.MC1OUT) {
+            CM1CON0bits.EN = 0;
+            return 1;
+        }
+        setup_CLCn_as_latch(1, 0x20);
+        setup_CLCn_as_latch(3, 0x20);
+        if (route_outputs(skew_routing)) {
+            flag = 2;
+        } else {
+            // Free-running Timer1 at FOSC, for the finest resolution.
+            T1CONbits.ON = 0;
+            T1CLKbits.CS = 0b00010; // FOSC
+            T1CONbits.CKPS = 0b00; // no prescale
+            T1CONbits.RD16 = 1;
+            T1GCONbits.GE = 0;
+            TMR1 = 0;
+            // The capture inputs come from the output pins themselves.
+            GIE = 0;
+            PPSLOCK = 0x55;
+            PPSLOCK = 0xaa;
+            PPSLOCKED = 0;
+            CCP1PPS = skew_pins[0];
+            CCP2PPS = skew_pins[k];
+            PPSLOCK = 0x55;
+            PPSLOCK = 0xaa;
+            PPSLOCKED = 1;
+            CCP1CONbits.MODE = 0b0101; // capture every rising edge
+            CCP1CAPbits.CTS = 0b0000; // CCP1PPS pin
+            CCP2CONbits.MODE = 0b0101;
+            CCP2CAPbits.CTS = 0b0000; // CCP2PPS pin
+            PIR3bits.CCP1IF = 0;
+            PIR8bits.CCP2IF = 0;
+            CCP1CONbits.EN = 1;
+            CCP2CONbits.EN = 1;
+            T1CONbits.ON = 1;
+            enable_CLCn(1);
+            enable_CLCn(3);
+            CM1CON0bits.POL = 0; // The event.
+            for (uint8_t i=0; i < 100 && !(PIR3bits.CCP1IF && PIR8bits.CCP2IF); ++i) {
+                __delay_us(1);
+            }
+            if (PIR3bits.CCP1IF && PIR8bits.CCP2IF) {
+                skew_ticks[k] = (int16_t)(CCPR2 - CCPR1);
+            } else {
+                flag = 3;
+            }
+        }
+        route_outputs(no_outputs);
+        CLCSELECT = 0; CLCnCONbits.EN = 0;
+        CLCSELECT = 2; CLCnCONbits.EN = 0;
+        T1CONbits.ON = 0;
+        CCP1CONbits.EN = 0;
+        CCP2CONbits.EN = 0;
+        CM1CON0bits.EN = 0;
+    }
+    return flag;
+} // end measure_output_skew()
+
+// Delay jitter, measured for TU16A and TU16B in three set-ups each:
+// 125ns ticks (PS=7) and FOSC cycles (PS=0), both with CSYNC,
+// and FOSC cycles without CSYNC. Each shot is forced as for 'd',
+// but nothing is routed to the pins: CCP1 captures CLC1_OUT, the latched
+// event, and CCP2 the latch on the timer output, with Timer1 at FOSC.
+// The time from enabling the latches to the event is stepped through
+// a few instruction cycles from shot to shot, so that the start falls
+// at different phases of the timer clock. A forced event is still
+// synchronous to FOSC, so the spreads are a lower bound for a real,
+// asynchronous event, by up to one FOSC cycle.
+#define NJITTER 6
+#define JITTER_TEST_TICKS 80 // 10us
+const char* const jitter_names[NJITTER] = {
+    "tu16a-tick", "tu16a-fosc", "tu16a-nosync",
+    "tu16b-tick", "tu16b-fosc", "tu16b-nosync"
+};
+uint16_t jitter_lo[NJITTER]; // delay after the event, in FOSC cycles
+uint16_t jitter_hi[NJITTER];
+
+void setup_jitter_timer(uint8_t b, uint8_t ps, uint8_t csync, uint16_t pr)
+{
+    // As for delay 0 or 1 of the simple trigger, b=0 for TU16A, 1 for TU16B.
+    if (b == 0) {
+        TU16ACON0bits.ON = 0;
+        TU16ACLK = 0b00010; // FOSC
+        TU16APS = ps;
+        TU16AHLTbits.CSYNC = csync;
+        TU16ACON1bits.OSEN = 0;
+        TU16ACON0bits.OM = 0;
+        TU16AHLTbits.START = 0b10; // rising ERS edge
+        TU16AHLTbits.RESET = 0;
+        TU16AHLTbits.STOP = 0b11; // at PR match
+        TU16AERS = 0b01110; // CLC1_OUT
+        TU16APR = pr;
+        TU16ACON1bits.CLR = 1;
+        setup_CLCn_as_latch(2, 0x36); // TU16A_OUT
+        TU16ACON0bits.ON = 1;
+    } else {
+        TU16BCON0bits.ON = 0;
+        TU16BCLK = 0b00010; // FOSC
+        TU16BPS = ps;
+        TU16BHLTbits.CSYNC = csync;
+        TU16BCON1bits.OSEN = 0;
+        TU16BCON0bits.OM = 0;
+        TU16BHLTbits.START = 0b10;
+        TU16BHLTbits.RESET = 0;
+        TU16BHLTbits.STOP = 0b11;
+        TU16BERS = 0b01110; // CLC1_OUT
+        TU16BPR = pr;
+        TU16BCON1bits.CLR = 1;
+        setup_CLCn_as_latch(4, 0x37); // TU16B_OUT
+        TU16BCON0bits.ON = 1;
+    }
+}
+
+uint8_t measure_delay_jitter(uint8_t shots)
+{
+    // Returns:
+    // 0 if every shot was captured,
+    // 1 if the comparator is already high at set-up time,
+    // 3 if an edge was not captured.
+    //
+    uint8_t flag = 0;
+    update_FVRs();
+    update_DACs();
+    update_PGAs();
+    TUCHAINbits.CH16AB = 0;
+    for (uint8_t c=0; c < NJITTER && flag == 0; ++c) {
+        uint8_t b = c / 3;
+        uint8_t fine = (c % 3) != 0;
+        uint8_t csync = (c % 3) != 2;
+        uint16_t pr = fine ? JITTER_TEST_TICKS*8 - 1 : JITTER_TEST_TICKS - 1;
+        jitter_lo[c] = 0xFFFF;
+        jitter_hi[c] = 0;
+        for (uint8_t i=0; i < shots && flag == 0; ++i) {
+            CLRWDT();
+            CM1NCH = cm1_input();
+            CM1PCH = 0b100; // DAC2_Output
+            CM1CON0bits.POL = 1;
+            CM1CON0bits.HYS = 0;
+            CM1CON0bits.SYNC = 0;
+            CM1CON0bits.EN = 1;
+            __delay_us(100);
+            if (CMOUTbits.MC1OUT) {
+                CM1CON0bits.EN = 0;
+                return 1;
+            }
+            setup_CLCn_as_latch(1, 0x20); // CMP1_OUT
+            setup_jitter_timer(b, fine ? 0 : 7, csync, pr);
+            T1CONbits.ON = 0;
+            T1CLKbits.CS = 0b00010; // FOSC
+            T1CONbits.CKPS = 0b00; // no prescale
+            T1CONbits.RD16 = 1;
+            T1GCONbits.GE = 0;
+            TMR1 = 0;
+            CCP1CONbits.MODE = 0b0101; // capture every rising edge
+            CCP1CAPbits.CTS = 0b0100; // CLC1_OUT
+            CCP2CONbits.MODE = 0b0101;
+            CCP2CAPbits.CTS = b ? 0b0111 : 0b0101; // CLC4_OUT or CLC2_OUT
+            PIR3bits.CCP1IF = 0;
+            PIR8bits.CCP2IF = 0;
+            CCP1CONbits.EN = 1;
+            CCP2CONbits.EN = 1;
+            T1CONbits.ON = 1;
+            enable_CLCn(b ? 4 : 2);
+            enable_CLCn(1);
+            for (uint8_t w = i & 7; w; --w) NOP();
+            CM1CON0bits.POL = 0; // The event.
+            for (uint8_t t=0; t < 100 && !(PIR3bits.CCP1IF && PIR8bits.CCP2IF); ++t) {
+                __delay_us(1);
+            }
+            if (PIR3bits.CCP1IF && PIR8bits.CCP2IF) {
+                uint16_t d = CCPR2 - CCPR1;
+                if (d < jitter_lo[c]) jitter_lo[c] = d;
+                if (d > jitter_hi[c]) jitter_hi[c] = d;
+            } else {
+                flag = 3;
+            }
+            for (uint8_t n=0; n < 4; n++) {
+                CLCSELECT = n;
+                CLCnCONbits.EN = 0;
+            }
+            TU16ACON0bits.ON = 0;
+            TU16BCON0bits.ON = 0;
+            T1CONbits.ON = 0;
+            CCP1CONbits.EN = 0;
+            CCP2CONbits.EN = 0;
+            CM1CON0bits.EN = 0;
+        }
+    }
+    return flag;
+} // end measure_delay_jitter()
+
+// Comparator crossings, for judging the noise on INa and INb
+// against the trigger levels in registers 1 and 2.
+#define MAX_CROSSING_MS 10000
+uint32_t crossings[2];
+uint16_t peak_crossings[2]; // most in any one millisecond
+
+void count_crossings(uint16_t ms)
+{
+    // With the comparators set up as for arming, but no outputs routed,
+    // count their rising edges with Timer1 (CMP1) and Timer3 (CMP2)
+    // as counters. The counts are collected every millisecond,
+    // timed by Timer0, to find the peak rate.
+    update_FVRs();
+    update_DACs();
+    update_PGAs();
+    CM1NCH = cm1_input(); // C1IN0- pin or OPA1_OUT
+    CM1PCH = 0b100; // DAC2_Output
+    CM1CON0bits.POL = 1;
+    CM1CON0bits.HYS = 0; // no hysteresis, as when armed
+    CM1CON0bits.SYNC = 0;
+    CM1CON0bits.EN = 1;
+    CM2NCH = cm2_input(); // C2IN3- pin or OPA2_OUT
+    CM2PCH = 0b101; // DAC3_Output
+    CM2CON0bits.POL = 1;
+    CM2CON0bits.HYS = 0;
+    CM2CON0bits.SYNC = 0;
+    CM2CON0bits.EN = 1;
+    //
+    T1CONbits.ON = 0;
+    T1CLKbits.CS = 0b01100; // CMP1_OUT (table 25-3)
+    T1CONbits.CKPS = 0b00; // every rising edge
+    T1CONbits.RD16 = 1;
+    T1GCONbits.GE = 0; // counts without a gate
+    PROFILE_CLOCK_LOST(); // Timer3 counts INb crossings
+    T3CONbits.ON = 0;
+    T3CLKbits.CS = 0b01101; // CMP2_OUT
+    T3CONbits.CKPS = 0b00;
+    T3CONbits.RD16 = 1;
+    T3GCONbits.GE = 0;
+    // Let the comparators settle, and any edge from switching
+    // the clock selections pass, before clearing the counts.
+    __delay_us(10);
+    TMR1 = 0;
+    TMR3 = 0;
+    timer0_start(0b0100); // 1:16 for 1us ticks
+    T1CONbits.ON = 1;
+    T3CONbits.ON = 1;
+    //
+    uint16_t last[2] = {0, 0};
+    uint16_t t_next = 1000;
+    crossings[0] = crossings[1] = 0;
+    peak_crossings[0] = peak_crossings[1] = 0;
+    for (uint16_t i=0; i < ms; ++i) {
+        while ((int16_t)(timer0_ticks() - t_next) < 0) { uptime_service(); CLRWDT(); }
+        t_next += 1000;
+        uint16_t now[2];
+        now[0] = TMR1;
+        now[1] = TMR3;
+        for (uint8_t k=0; k < 2; ++k) {
+            uint16_t n = now[k] - last[k];
+            last[k] = now[k];
+            crossings[k] += n;
+            if (n > peak_crossings[k]) peak_crossings[k] = n;
+        }
+    }
+    T0CON0bits.EN = 0;
+    T1CONbits.ON = 0;
+    T3CONbits.ON = 0;
+    CM1CON0bits.EN = 0;
+    CM2CON0bits.EN = 0;
+    PROFILE_CLOCK_RESTART();
+} // end count_crossings()
+
+uint8_t calibrate_clock(uint8_t ch, uint16_t period_us, uint8_t nperiods,
+                        uint32_t* measured, uint32_t* expected)
+{
+    // Measure nperiods of a reference pulse train of known period
+    // arriving on INa (ch=0) or INb (ch=1), counting 125ns ticks
+    // of Timer1 between rising edges seen by the comparator.
+    // The relative error of the count is the HFINTOSC error,
+    // which we store in register 7 as parts per million.
+    //
+    // Returns:
+    // 0 if the measurement succeeded and register 7 was updated,
+    // 1 if the reference period is not measurable with Timer1,
+    // 2 if no reference edges arrived within the time-out,
+    // 3 if the clock error is too large to be believable.
+    //
+    if (period_us == 0 || period_us > 8000 || nperiods == 0) return 1;
+    *expected = (uint32_t)nperiods * period_us * 8;
+    if (*expected < 64) return 1; // too few ticks to resolve the error
+    *measured = 0;
+    update_FVRs();
+    update_DACs();
+    update_PGAs();
+    // Comparator set-up follows that of the trigger functions
+    // except that we want hysteresis to get clean edges
+    // from a repetitive reference signal.
+    if (ch == 0) {
+        CM1NCH = cm1_input(); // C1IN0- pin or OPA1_OUT
+        CM1PCH = 0b100; // DAC2_Output
+        CM1CON0bits.POL = 1;
+        CM1CON0bits.HYS = 1;
+        CM1CON0bits.SYNC = 0;
+        CM1CON0bits.EN = 1;
+    } else {
+        CM2NCH = cm2_input(); // C2IN3- pin or OPA2_OUT
+        CM2PCH = 0b101; // DAC3_Output
+        CM2CON0bits.POL = 1;
+        CM2CON0bits.HYS = 1;
+        CM2CON0bits.SYNC = 0;
+        CM2CON0bits.EN = 1;
+    }
+    // Free-running Timer1 with the same 125ns ticks as used for the delays.
+    T1CONbits.ON = 0;
+    T1CLKbits.CS = 0b00001; // FOSC/4
+    T1CONbits.CKPS = 0b01; // prescale 1:2 to get 125ns ticks
+    T1CONbits.RD16 = 1;
+    T1GCONbits.GE = 0; // count continuously
+    TMR1 = 0;
+    CCP1CONbits.MODE = 0b0101; // capture TMR1 on every rising edge
+    CCP1CAPbits.CTS = (ch == 0) ? 0b0010 : 0b0011; // CMP1_OUT or CMP2_OUT
+    CCP1CONbits.EN = 1;
+    T1CONbits.ON = 1;
+    //
+    // Differences between 16-bit captures are good
+    // so long as the period is shorter than the 8.19ms timer roll-over.
+    uint8_t flag = 0;
+    uint16_t previous = 0;
+    for (uint8_t i=0; i <= nperiods; ++i) {
+        uint8_t overflows = 0;
+        PIR3bits.CCP1IF = 0;
+        PIR3bits.TMR1IF = 0;
+        while (!PIR3bits.CCP1IF) {
+            uptime_service();
+            CLRWDT();
+            if (PIR3bits.TMR1IF) {
+                PIR3bits.TMR1IF = 0;
+                if (++overflows > 4) break;
+            }
+        }
+        if (!PIR3bits.CCP1IF) { flag = 2; break; }
+        uint16_t now = CCPR1;
+        if (i > 0) { *measured += (uint16_t)(now - previous); }
+        previous = now;
+    }
+    T1CONbits.ON = 0;
+    CCP1CONbits.EN = 0;
+    CM1CON0bits.EN = 0;
+    CM2CON0bits.EN = 0;
+    if (flag) return flag;
+    //
+    // A fast oscillator gives more ticks than expected.
+    // Note that 1000000 = 15625 * 64, which keeps the arithmetic in 32 bits:
+    // an error beyond 1/32 (31250ppm) is refused before the multiply,
+    // and a long measurement is scaled down to at most 2^22 ticks,
+    // so that |diff| * 15625 stays below 2^31.
+    uint32_t e = *expected;
+    int32_t diff = (int32_t)*measured - (int32_t)e;
+    int32_t limit = (int32_t)(e / 32);
+    if (diff > limit || diff < -limit) return 3;
+    while (e > 0x400000UL) { e >>= 1; diff /= 2; }
+    int32_t ppm = (diff * 15625L) / (int32_t)(e >> 6);
+    if (ppm > MAX_CLOCK_CORR_PPM || ppm < -MAX_CLOCK_CORR_PPM) return 3;
+    vregister[7] = (int16_t)ppm;
+    arm_plan_compile();
+    save_register_to_EEPROM(7);
+    return 0;
+} // end calibrate_clock()
+
+void stage_shot_record(uint8_t flag)
+{
+    // Count the shot for the status record.
+    // The journal record is written to flash later, from the main loop,
+    // once the reply has gone.
+    armed_now = 0;
+    last_flag = flag;
+    shot_count++;
+    journal_record_t r;
+    r.mode = (uint8_t)vregister[0];
+    r.flag = flag;
+    r.tof = (r.mode == 1 && flag == 0) ? last_tof : 0;
+    r.pr_value = (r.mode == 1 && flag == 0) ? last_pr_value : 0;
+    r.level_a = DAC2DATL; // as used, which may have tracked the baseline
+    r.level_b = DAC3DATL;
+    r.delay_2 = (uint16_t)vregister[6];
+    journal_stage(&r);
+}
+
+void arm_and_wait_for_event(uint8_t style)
 {
-    int nchar;
     uint8_t flag;
+    arm_reply_style = style;
+    arm_announced = 0;
+    arm_ack_pending = 0;
+    timer0_start(ARM_TIMER_CKPS); // for the arm latency and the reply slot
     switch (vregister[0]) {
         case 0:
-            putstr("Armed simple trigger, using INa only: ");
             flag = trigger_simple();
+            stage_shot_record(flag);
+            if (!arm_announced) begin_arm_reply();
             if (flag == 1) {
                 putstr("C1OUT already high. fail\n");
             } else if (flag == 2) {
@@ -776,15 +2338,34 @@ void arm_and_wait_for_event(void)
                 putstr("delay1 timer TU16B started too soon. fail\n");
             } else if (flag == 4) {
                 putstr("delay2 timer TMR1/CCP1 output set too soon. fail\n");
+            } else if (flag == 5) {
+                putstr("output routing not verified. fail\n");
+            } else if (flag == 6) {
+                putstr("pulse train settings do not fit. fail\n");
+            } else if (flag == 7) {
+                putstr("vdd-mV=");
+                reply_uint(vdd_mV);
+                putstr(" outside supply window. fail\n");
             } else if (flag == 0) {
+                if (vregister[16] > 0) {
+                    putstr("level-a=");
+                    reply_uint(DAC2DATL);
+                    putch(' ');
+                }
+                if (arm_plan.jitter_ns > 0) {
+                    putstr("jitter-ns=");
+                    reply_uint(arm_plan.jitter_ns);
+                    putch(' ');
+                }
                 putstr("triggered. ok\n");
             } else {
                 putstr("unknown flag value. fail\n");
             }
             break;
         case 1:
-            putstr("Armed time-of-flight trigger, using INa followed by INb: ");
             flag = trigger_TOF();
+            stage_shot_record(flag);
+            if (!arm_announced) begin_arm_reply();
             if (flag == 1) {
                 putstr("C1OUT already high. fail\n");
             } else if (flag == 2) {
@@ -797,23 +2378,353 @@ void arm_and_wait_for_event(void)
                 putstr("delay0 timer TU16A started too soon. fail\n");
             } else if (flag == 6) {
                 putstr("delay1 timer TU16B started too soon. fail\n");
+            } else if (flag == 7) {
+                putstr("output routing not verified. fail\n");
+            } else if (flag == 8) {
+                putstr("pulse train settings do not fit. fail\n");
+            } else if (flag == 9) {
+                putstr("vdd-mV=");
+                reply_uint(vdd_mV);
+                putstr(" outside supply window. fail\n");
+            } else if (flag == 10) {
+                putstr("Event4 or Event5 settings do not fit. fail\n");
             } else if (flag == 0) {
+                // Some debug (but, maybe, we'll keep it)
+                putstr("tof=");
+                reply_uint(last_tof);
+                putstr(" pr=");
+                reply_int((int16_t)last_pr_value);
+                putch(' ');
+                if (arm_plan.ev_mult[1]) {
+                    putstr("ev4=");
+                    reply_uint(last_ev_value[0]);
+                    putch(' ');
+                }
+                if (arm_plan.ev_mult[2]) {
+                    putstr("ev5=");
+                    reply_uint(last_ev_value[1]);
+                    putch(' ');
+                }
+                if (last_late) {
+                    putstr("late=");
+                    reply_uint(last_late);
+                    putch(' ');
+                }
+                if (vregister[16] > 0) {
+                    putstr("level-a=");
+                    reply_uint(DAC2DATL);
+                    putstr(" level-b=");
+                    reply_uint(DAC3DATL);
+                    putch(' ');
+                }
+                if (arm_plan.jitter_ns > 0) {
+                    putstr("jitter-ns=");
+                    reply_uint(arm_plan.jitter_ns);
+                    putch(' ');
+                }
                 putstr("triggered. ok\n");
             } else {
                 putstr("unknown flag value. fail\n");
             }
             break;
         default:
+            begin_arm_reply();
             putstr("Unknown mode. fail\n");
     }
+    // The event may have come before our slot.
+    while (arm_ack_pending) { armed_wait(); }
+    T0CON0bits.EN = 0;
+    if (style == ARM_REPLY_EARLY) uart1_mute(broadcast_command);
+    arm_reply_style = ARM_REPLY_NONE;
 }
 
 // For incoming serial communication
 #define NBUFA 80
 char bufA[NBUFA];
-// For outgoing serial communication
-#define NBUFB 128
-char bufB[NBUFB];
+// Outgoing replies are formatted directly into the transmit ring
+// by the functions in reply.c.
+
+uint8_t change_baud_rate(int16_t code)
+// Switch to the new rate and wait for the host to send the line "ok".
+// Without that confirmation, go back to the old rate so that
+// the host can still talk to us.
+// Returns 0 if the new rate was confirmed (and saved), 1 otherwise.
+{
+    long old_baud = selected_baud_rate();
+    long new_baud = baud_rates[code];
+    putstr("switching to ");
+    reply_long(new_baud);
+    putstr(" baud, confirm with ok\n");
+    uart1_set_baud(new_baud);
+    for (uint16_t t=0; t < 2000; t++) {
+        if (uart1_line_ready()) {
+            getstr(bufA, NBUFA);
+            if (strcmp(bufA, "ok") == 0) {
+                vregister[9] = code;
+                save_register_to_EEPROM(9);
+                return 0;
+            }
+        }
+        __delay_ms(1);
+        uptime_service();
+        CLRWDT();
+    }
+    uart1_set_baud(old_baud);
+    return 1;
+}
+
+// Binary protocol state.
+uint8_t binary_mode = 0;
+bp_parser_t bp_in;
+uint8_t bp_reply[BP_MAXPAYLOAD];
+uint8_t bp_frame[BP_MAXPAYLOAD+BP_OVERHEAD];
+
+// Start-up diagnostics, reported by the 'i' command.
+#define NRESETCAUSE 10
+const char* reset_cause_names[NRESETCAUSE] = {"unknown",
+    "power-on", "brown-out", "watchdog", "watchdog-window", "MCLR",
+    "RESET-instruction", "stack-overflow", "stack-underflow", "memory-violation"
+};
+uint8_t reset_cause = 0;
+uint32_t boot_time_us = 0;
+
+uint8_t read_reset_cause(void)
+{
+    // Reset condition flags in PCON0 and PCON1, Section 8.14 of the data sheet.
+    // Most are cleared by the hardware when their reset occurs,
+    // so we set them again to be ready to identify the next reset.
+    uint8_t cause = 0;
+    if (!PCON0bits.POR) { cause = 1; }
+    else if (!PCON0bits.BOR) { cause = 2; }
+    else if (!PCON0bits.RWDT) { cause = 3; }
+    else if (!PCON0bits.WDTWV) { cause = 4; }
+    else if (!PCON0bits.RMCLR) { cause = 5; }
+    else if (!PCON0bits.RI) { cause = 6; }
+    else if (PCON0bits.STKOVF) { cause = 7; }
+    else if (PCON0bits.STKUNF) { cause = 8; }
+    else if (!PCON1bits.MEMV) { cause = 9; }
+    PCON0bits.POR = 1;
+    PCON0bits.BOR = 1;
+    PCON0bits.RWDT = 1;
+    PCON0bits.WDTWV = 1;
+    PCON0bits.RMCLR = 1;
+    PCON0bits.RI = 1;
+    PCON0bits.STKOVF = 0;
+    PCON0bits.STKUNF = 0;
+    PCON1bits.MEMV = 1;
+    return cause;
+}
+
+// Compact status for supervisory polling, 'x' and BP_OP_STATUS,
+// formatted without printf so that it costs little to send.
+// The text form is fixed width, in hexadecimal:
+// armed mode flag tof pr shots uptime reset framing overflow long-lines overrun
+// e.g. 0 1 00 0C80 FFF6 0003 000012A4 1 0000 0000 0000 0000 ok
+void reply_status(void)
+{
+    uint16_t framing, overflow, truncated, overrun;
+    uart1_error_counts(&framing, &overflow, &truncated, &overrun);
+    reply_hex(armed_now, 1);
+    putch(' ');
+    reply_hex((uint32_t)vregister[0], 1);
+    putch(' ');
+    reply_hex(last_flag, 2);
+    putch(' ');
+    reply_hex(last_tof, 4);
+    putch(' ');
+    reply_hex(last_pr_value, 4);
+    putch(' ');
+    reply_hex(shot_count, 4);
+    putch(' ');
+    reply_hex(uptime_ticks(), 8);
+    putch(' ');
+    reply_hex(reset_cause, 1);
+    putch(' ');
+    reply_hex(framing, 4);
+    putch(' ');
+    reply_hex(overflow, 4);
+    putch(' ');
+    reply_hex(truncated, 4);
+    putch(' ');
+    reply_hex(overrun, 4);
+    putstr(" ok\n");
+}
+
+uint8_t put_status_record(uint8_t* buf)
+// The binary form, little-endian, as listed in binproto.h.
+// Returns the number of bytes.
+{
+    uint16_t framing, overflow, truncated, overrun;
+    uart1_error_counts(&framing, &overflow, &truncated, &overrun);
+    uint32_t up = uptime_ticks();
+    buf[0] = armed_now;
+    buf[1] = (uint8_t)vregister[0];
+    buf[2] = last_flag;
+    buf[3] = (uint8_t)(last_tof & 0x00FF);
+    buf[4] = (uint8_t)(last_tof >> 8);
+    buf[5] = (uint8_t)(last_pr_value & 0x00FF);
+    buf[6] = (uint8_t)(last_pr_value >> 8);
+    buf[7] = (uint8_t)(shot_count & 0x00FF);
+    buf[8] = (uint8_t)(shot_count >> 8);
+    buf[9] = (uint8_t)(up & 0xFF);
+    buf[10] = (uint8_t)((up >> 8) & 0xFF);
+    buf[11] = (uint8_t)((up >> 16) & 0xFF);
+    buf[12] = (uint8_t)((up >> 24) & 0xFF);
+    buf[13] = reset_cause;
+    buf[14] = (uint8_t)(framing & 0x00FF);
+    buf[15] = (uint8_t)(framing >> 8);
+    buf[16] = (uint8_t)(overflow & 0x00FF);
+    buf[17] = (uint8_t)(overflow >> 8);
+    buf[18] = (uint8_t)(truncated & 0x00FF);
+    buf[19] = (uint8_t)(truncated >> 8);
+    buf[20] = (uint8_t)(overrun & 0x00FF);
+    buf[21] = (uint8_t)(overrun >> 8);
+    return 22;
+}
+
+// Help text is sent by DMA directly from program flash.
+const char help_text[] =
+    "\nPIC18F46Q71-I/P X2-trigger+timer commands and registers\n"
+    "\n"
+    "Commands:\n"
+    " h or ? print this help message\n"
+    " v      report version of firmware\n"
+    " n      report number of registers\n"
+    " p      report register values\n"
+    " r <i>  report value of register i\n"
+    " s <i> <j>  set register i to value j, within the range listed below.\n"
+    "        Times may be given in ns or us (e.g. 1500ns), and levels\n"
+    "        in mV at the input pin for the Vref and gain set at the time.\n"
+    " R      restore register values from EEPROM\n"
+    " S      save register values to EEPROM\n"
+    " F      set register values to original values\n"
+    " a      arm device and wait for event; the reply gives jitter-ns,\n"
+    "        the most that the delay timers (and TOF) may vary the outputs.\n"
+    "        In TOF mode it starts with tof, pr (Event3) and, if wanted,\n"
+    "        ev4 and ev5, in ticks after Event1 (registers 23 to 29),\n"
+    "        then late, bit k set if Event(k+3) had passed by Event2\n"
+    "        and came a roll-over (8.19 ms) late\n"
+    " A      arm device, replying armed <latency-us> ok as soon as it is armed\n"
+    "        and not reporting the event. As @* A, nodes reply in turn,\n"
+    "        10 ms plus one slot per node address after the command.\n"
+    " P [live|plan]  report the arm plan, the values set up by a and A,\n"
+    "        which is worked out whenever the registers change:\n"
+    "        mode, FVR gain, DAC codes, op-amp GSEL, CMxNCH, corrected\n"
+    "        delays in ticks, or FOSC cycles for those with bits set\n"
+    "        in fine, expected jitter, pulse train (CLC6 start, PWM1PR, PWM1S1P1,\n"
+    "        TMR3 preset) and the RxyPPS codes for OUT0 to OUT7.\n"
+    "        P live has each arm work out the plan and set up afresh,\n"
+    "        stage by stage, as before there was a plan, so that\n"
+    "        the latency reported by A can be compared; P plan goes back.\n"
+    " q      report the probe counts, in instruction cycles (62.5 ns):\n"
+    "        count last min max for command, getstr, eeprom-save,\n"
+    "        simple-setup, tof-setup, arm-analog and route,\n"
+    "        in a build with X2_PROFILE defined\n"
+    " Q      clear the probe counts\n"
+    " d      fire the outputs, as a simple trigger without delays would,\n"
+    "        and report the skew of OUT3, OUT6 and OUT7 after OUT0 in ns\n"
+    "        (15.6 ns resolution). OUT1, OUT2, OUT4 and OUT5 on port D are\n"
+    "        not checked; the capture inputs cannot reach port D.\n"
+    "        Disconnect anything the outputs would fire.\n"
+    " D [n]  force n shots (16, 2-255) through TU16A and TU16B, with no outputs\n"
+    "        routed, for each of tick (125 ns), fosc (15.6 ns) and nosync\n"
+    "        (fosc without CSYNC), and report the 10 us test delay as\n"
+    "        shortest+spread in ns, then the jitter expected with the\n"
+    "        registers as they are (register 22 and the delays)\n"
+    " i      report cause of the last reset and time taken to start\n"
+    " H      health scan: FVR (from the factory calibration), VDD,\n"
+    "        die temperature and the INa and INb levels in mV,\n"
+    "        measured together with VDD as the ADC reference\n"
+    " x      report status in one fixed-width line of hexadecimal fields:\n"
+    "        armed mode flag tof pr shots uptime reset uart-errors\n"
+    "        armed 1 while waiting for the event; flag of the last shot\n"
+    "        (FF before the first); tof and pr of the last TOF shot;\n"
+    "        shots since reset; uptime in 4.096 ms ticks; reset cause\n"
+    "        as listed by i (0 unknown, 1 power-on, 2 brown-out, ...);\n"
+    "        receive framing errors, FIFO overflows, over-long lines and\n"
+    "        receive ring overruns (characters lost while busy).\n"
+    "        After A, x is answered while armed.\n"
+    " j      list the shot journal, oldest first (up to 128 shots,\n"
+    "        kept in flash across resets; flag 0 is a good shot)\n"
+    " J      erase the shot journal\n"
+    " N [<ms>]  count comparator crossings of the INa and INb levels\n"
+    "        over ms (default 100, up to 10000), with the most in any ms.\n"
+    "        No outputs are driven.\n"
+    // Get ADC Positive Input Channel Selections from Table 41-7 in the data sheet
+    " c <i>  convert analogue channel i (12-bit result, 0-4095)\n"
+    "        i=57 DAC2_output (INa)\n"
+    "        i=58 DAC3_output (INb)\n"
+    "        i=0  RA0/C1IN0- (INa)\n"
+    "        i=9  RB1/C2IN3- (INb)\n"
+    "        i=59 OPA1_output (INa amplified)\n"
+    "        i=60 OPA2_output (INb amplified)\n"
+    "        With the op-amps on (register 19), i=0 and i=9 are read\n"
+    "        through them and divided by the gain.\n"
+    " B      switch to binary framed protocol (see binproto.h),\n"
+    "        only with node-address 0, because frames carry no address\n"
+    " b <i>  switch to baud code i (see register 9); the host must send\n"
+    "        the line ok at the new rate within 2 s or the node falls back.\n"
+    "        On confirmation, the code is saved to EEPROM.\n"
+    "        A node with an address takes b only from @* b, so that\n"
+    "        the nodes on a multidrop bus change rate together.\n"
+    " k <i> <p> [<n>]  calibrate clock against n periods (default 16)\n"
+    "        of a p microsecond reference pulse train on i=0 INa, 1 INb\n"
+    "        (trigger level from register 1 or 2; result saved to EEPROM)\n"
+    "\n"
+    "On a multidrop bus, address a command with @<n> before any tag.\n"
+    "Use @* to have all nodes act on a command without replying.\n"
+    "A node with address 0 acts on unaddressed commands, others ignore them.\n"
+    "\n"
+    "Any command may be preceded by a sequence tag #<t> (up to 8 characters)\n"
+    "which is echoed at the start of the reply, e.g. #12 r 1 -> #12 5 (level-a) ok\n"
+    "\n"
+    "Registers (index name min..max units):\n";
+
+void reply_register_help(void)
+{
+    for (uint8_t i=0; i < NUMREG; ++i) {
+        const register_schema_t* r = &register_schema[i];
+        putch(' ');
+        reply_uint(i);
+        putch(' ');
+        putstr(r->name);
+        putch(' ');
+        reply_long(r->min);
+        putstr("..");
+        reply_long(r->max);
+        if (r->unit != UNIT_NONE) {
+            putch(' ');
+            putstr(unit_names[r->unit]);
+        }
+        putstr("\n    ");
+        putstr(r->help);
+        putch('\n');
+    }
+}
+
+void reply_profile()
+{
+#ifdef X2_PROFILE
+    // Counts are of instruction cycles, 62.5ns each.
+    putstr("probe count last min max (cycles)\n");
+    probe_stats_t st;
+    for (uint8_t i=0; profile_read(i, &st); ++i) {
+        putstr(probe_names[i]);
+        putch(' ');
+        reply_uint(st.count);
+        putch(' ');
+        reply_ulong(st.last);
+        putch(' ');
+        reply_ulong(st.min);
+        putch(' ');
+        reply_ulong(st.max);
+        putch('\n');
+    }
+    putstr("ok\n");
+#else
+    putstr("probes not built in; define X2_PROFILE. fail\n");
+#endif
+}
 
 void interpret_command(char* cmdStr)
 // We intend that valid commands are answered quickly
@@ -824,26 +2735,33 @@ void interpret_command(char* cmdStr)
 {
     char* token_ptr;
     const char* sep_tok = ", ";
-    int nchar;
     uint8_t i, j;
     int16_t v;
-    // nchar = printf("DEBUG: cmdStr=%s", cmdStr);
+    PROBE_BEGIN(PROBE_COMMAND);
     switch (cmdStr[0]) {
         case 'v':
-            nchar = snprintf(bufB, NBUFB, "%s\n", VERSION_STR);
-            putstr(bufB);
+            putstr(VERSION_STR);
+            putstr(" clock-corr=");
+            reply_int(vregister[7]);
+            putstr("ppm\n");
             break;
         case 'n':
-            nchar = snprintf(bufB, NBUFB, "%u ok\n", NUMREG);
-            putstr(bufB);
+            reply_int_ok(NUMREG);
+            break;
+        case 'x':
+            reply_status();
+            break;
+        case 'i':
+            putstr("reset=");
+            putstr(reset_cause_names[reset_cause]);
+            putstr(" boot-us=");
+            reply_ulong(boot_time_us);
+            putstr(" ok\n");
             break;
         case 'p':
-            nchar = snprintf(bufB, NBUFB, "Register values:\n");
-            putstr(bufB);
+            putstr("Register values:\n");
             for (i=0; i < NUMREG; ++i) {
-                nchar = snprintf(bufB, NBUFB, "reg[%d]=%d (%s)\n",
-                        i, vregister[i], hints[i]);
-                putstr(bufB);
+                reply_register(i, register_value(i), register_schema[i].name);
             }
             putstr("ok\n");
             break;
@@ -854,9 +2772,10 @@ void interpret_command(char* cmdStr)
                 // Found some nonblank text, assume register number.
                 i = (uint8_t) atoi(token_ptr);
                 if (i < NUMREG) {
-                    v = vregister[i];
-                    nchar = snprintf(bufB, NBUFB, "%d (%s) ok\n", v, hints[i]);
-                    putstr(bufB);
+                    reply_long(register_value(i));
+                    putstr(" (");
+                    putstr(register_schema[i].name);
+                    putstr(") ok\n");
                 } else {
                     putstr("fail\n");
                 }
@@ -875,12 +2794,26 @@ void interpret_command(char* cmdStr)
                     token_ptr = strtok(NULL, sep_tok);
                     if (token_ptr) {
                         // Assume text is value for register.
-                        v = (int16_t) atoi(token_ptr);
-                        vregister[i] = v;
-                        nchar = snprintf(bufB, NBUFB, "reg[%u] %d (%s) ok\n", i, v, hints[i]);
-                        puts(bufB);
-                        if (i == 3) { update_FVRs(); }
-                        if (i == 1 || i == 2) { update_DACs(); }
+                        int32_t value;
+                        if (register_read_only(i)) {
+                            putstr(register_schema[i].name);
+                            putstr(" is read-only. fail\n");
+                            break;
+                        }
+                        j = parse_register_value(i, token_ptr, &value);
+                        if (j != VALUE_OK) {
+                            reply_value_rejected(i, j);
+                            break;
+                        }
+                        set_register(i, (int16_t)value);
+                        // The extra newline is as puts() used to give.
+                        putstr("reg[");
+                        reply_uint(i);
+                        putstr("] ");
+                        reply_long(value);
+                        putstr(" (");
+                        putstr(register_schema[i].name);
+                        putstr(") ok\n\n");
                     } else {
                         putstr("fail\n");
                     }
@@ -910,7 +2843,171 @@ void interpret_command(char* cmdStr)
             putstr("ok\n");
             break;
         case 'a':
-            arm_and_wait_for_event();
+            // Arming waits for the event, so it is not counted as a command;
+            // the set-up has probes of its own.
+            PROBE_CANCEL(PROBE_COMMAND);
+            arm_and_wait_for_event(ARM_REPLY_TEXT);
+            break;
+        case 'A':
+            PROBE_CANCEL(PROBE_COMMAND);
+            arm_and_wait_for_event(ARM_REPLY_EARLY);
+            break;
+        case 'q':
+            reply_profile();
+            break;
+        case 'Q':
+#ifdef X2_PROFILE
+            profile_reset();
+            putstr("ok\n");
+#else
+            putstr("probes not built in; define X2_PROFILE. fail\n");
+#endif
+            break;
+        case 'P':
+            // Show the arm plan, or choose how arming uses it.
+            token_ptr = strtok(&cmdStr[1], sep_tok);
+            if (token_ptr) {
+                if (strcmp(token_ptr, "live") == 0) {
+                    arm_plan_live = 1;
+                } else if (strcmp(token_ptr, "plan") == 0) {
+                    arm_plan_live = 0;
+                } else {
+                    putstr("fail\n");
+                    break;
+                }
+            }
+            reply_arm_plan();
+            break;
+        case 'd':
+            // Measure the skew between outputs.
+            switch (measure_output_skew()) {
+                case 0: {
+                    int16_t lo = 0, hi = 0;
+                    putstr("skew-ns");
+                    for (i=0; i < NSKEW; ++i) {
+                        putstr(" OUT");
+                        reply_uint(skew_outputs[i]);
+                        putch('=');
+                        reply_long((int32_t)skew_ticks[i] * 125 / 8);
+                        if (skew_ticks[i] < lo) lo = skew_ticks[i];
+                        if (skew_ticks[i] > hi) hi = skew_ticks[i];
+                    }
+                    putstr(" worst=");
+                    reply_long((int32_t)(hi - lo) * 125 / 8);
+                    putstr(" ok\n");
+                    break;
+                }
+                case 1: putstr("C1OUT already high. fail\n"); break;
+                case 2: putstr("output routing not verified. fail\n"); break;
+                default: putstr("edge not captured. fail\n");
+            }
+            break;
+        case 'D':
+            // Measure the jitter of the delay timers.
+            token_ptr = strtok(&cmdStr[1], sep_tok);
+            v = (token_ptr) ? (int16_t)atoi(token_ptr) : 16;
+            if (v < 2 || v > 255) {
+                putstr("fail\n");
+                break;
+            }
+            switch (measure_delay_jitter((uint8_t)v)) {
+                case 0:
+                    putstr("delay-ns");
+                    for (i=0; i < NJITTER; ++i) {
+                        putch(' ');
+                        putstr(jitter_names[i]);
+                        putch('=');
+                        reply_long((int32_t)jitter_lo[i] * 125 / 8);
+                        putch('+');
+                        reply_long((int32_t)(jitter_hi[i] - jitter_lo[i]) * 125 / 8);
+                    }
+                    putstr(" expected-jitter-ns=");
+                    reply_uint(arm_plan.jitter_ns);
+                    putstr(" ok\n");
+                    break;
+                case 1: putstr("C1OUT already high. fail\n"); break;
+                default: putstr("edge not captured. fail\n");
+            }
+            break;
+        case 'j':
+            // Stream the shot journal, oldest first.
+            putstr("Shot journal:\n");
+            for (i=0, j=0; j < JOURNAL_SLOTS; ++j) {
+                journal_record_t r;
+                CLRWDT();
+                if (!journal_read(j, &r)) continue;
+                putstr("seq=");
+                reply_uint(r.seq);
+                putstr(" mode=");
+                reply_uint(r.mode);
+                putstr(" flag=");
+                reply_uint(r.flag);
+                putstr(" tof=");
+                reply_uint(r.tof);
+                putstr(" pr=");
+                reply_uint(r.pr_value);
+                putstr(" level-a=");
+                reply_uint(r.level_a);
+                putstr(" level-b=");
+                reply_uint(r.level_b);
+                putstr(" delay-2=");
+                reply_uint(r.delay_2);
+                putch('\n');
+                ++i;
+            }
+            reply_uint(i);
+            putstr(" records ok\n");
+            break;
+        case 'J':
+            // Erase the shot journal.
+            journal_erase();
+            putstr("ok\n");
+            break;
+        case 'N':
+            // Count comparator crossings over an interval in ms.
+            token_ptr = strtok(&cmdStr[1], sep_tok);
+            v = (token_ptr) ? (int16_t)atoi(token_ptr) : 100;
+            if (v < 1 || v > MAX_CROSSING_MS) {
+                putstr("fail\n");
+                break;
+            }
+            count_crossings((uint16_t)v);
+            putstr("crossings ina=");
+            reply_ulong(crossings[0]);
+            putstr(" inb=");
+            reply_ulong(crossings[1]);
+            putstr(" peak-per-ms ina=");
+            reply_uint(peak_crossings[0]);
+            putstr(" inb=");
+            reply_uint(peak_crossings[1]);
+            putstr(" ok\n");
+            break;
+        case 'H':
+            // Health scan, in calibrated units.
+            health_scan();
+            if (vdd_mV == 0) {
+                putstr("VDD not measured. fail\n");
+                break;
+            }
+            putstr("fvr-mV=");
+            reply_uint(fvr1x_mV);
+            putstr(" vdd-mV=");
+            reply_uint(vdd_mV);
+            putstr(" temp-C=");
+            if (temperature_calibrated) {
+                v = temperature_dC;
+                if (v < 0) { putch('-'); v = -v; }
+                reply_uint((uint16_t)(v / 10));
+                putch('.');
+                putch((char)('0' + v % 10));
+            } else {
+                putstr("uncalibrated");
+            }
+            putstr(" ina-mV=");
+            reply_uint(input_mV[0]);
+            putstr(" inb-mV=");
+            reply_uint(input_mV[1]);
+            putstr(" ok\n");
             break;
         case 'c':
             // Report an ADC value.
@@ -918,10 +3015,10 @@ void interpret_command(char* cmdStr)
             if (token_ptr) {
                 // Found some nonblank text, assume channel number.
                 i = (uint8_t) atoi(token_ptr);
-                if (i == 0 || i == 9 || i == 57 || i == 58) {
-                    v = (int16_t)ADC_read(i);
-                    nchar = snprintf(bufB, NBUFB, "%d ok\n", v);
-                    putstr(bufB);
+                if (ADC_channel_allowed(i)) {
+                    update_PGAs();
+                    v = (int16_t)ADC_read_input(i);
+                    reply_int_ok(v);
                 } else {
                     putstr("fail\n");
                 }
@@ -929,68 +3026,406 @@ void interpret_command(char* cmdStr)
                 putstr("fail\n");
             }
             break;
+        case 'k':
+            // Calibrate the system clock against a reference pulse train.
+            token_ptr = strtok(&cmdStr[1], sep_tok);
+            if (token_ptr) {
+                // Channel 0=INa, 1=INb
+                i = (uint8_t) atoi(token_ptr);
+                token_ptr = strtok(NULL, sep_tok);
+                if (i < 2 && token_ptr) {
+                    uint16_t period_us = (uint16_t) atoi(token_ptr);
+                    uint8_t nperiods = 16;
+                    uint32_t measured, expected;
+                    token_ptr = strtok(NULL, sep_tok);
+                    if (token_ptr) { nperiods = (uint8_t) atoi(token_ptr); }
+                    j = calibrate_clock(i, period_us, nperiods, &measured, &expected);
+                    if (j == 0) {
+                        putstr("clock-corr=");
+                        reply_int(vregister[7]);
+                        putstr("ppm (");
+                        reply_ulong(measured);
+                        putstr(" ticks, expected ");
+                        reply_ulong(expected);
+                        putstr(") ok\n");
+                    } else if (j == 1) {
+                        putstr("period not measurable. fail\n");
+                    } else if (j == 2) {
+                        putstr("no reference edges. fail\n");
+                    } else {
+                        putstr("clock error too large (");
+                        reply_ulong(measured);
+                        putstr(" ticks, expected ");
+                        reply_ulong(expected);
+                        putstr("). fail\n");
+                    }
+                } else {
+                    putstr("fail\n");
+                }
+            } else {
+                putstr("fail\n");
+            }
+            break;
+        case 'b':
+            // Change baud rate, falling back if the host does not follow.
+            // On a multidrop bus, all of the nodes must change together,
+            // so an addressed node takes this only from an @* line.
+            token_ptr = strtok(&cmdStr[1], sep_tok);
+            if (vregister[8] != 0 && !broadcast_command) {
+                putstr("b must be sent to all nodes as @* b. fail\n");
+            } else if (token_ptr) {
+                v = (int16_t) atoi(token_ptr);
+                if (v >= 0 && v < NBAUD) {
+                    if (change_baud_rate(v)) {
+                        putstr("no confirmation, baud unchanged. fail\n");
+                    } else {
+                        putstr("baud ");
+                        reply_long(baud_rates[v]);
+                        putstr(" ok\n");
+                    }
+                } else {
+                    putstr("fail\n");
+                }
+            } else {
+                putstr("fail\n");
+            }
+            break;
+        case 'B':
+            // Switch to the binary protocol until a BP_OP_EXIT frame.
+            // The PC should wait for this reply before sending frames.
+            // Frames carry no node address, so every node on a multidrop
+            // bus would reply to them; only point-to-point nodes take 'B'.
+            if (vregister[8] != 0) {
+                putstr("binary mode needs node-address 0. fail\n");
+                break;
+            }
+            putstr("binary mode ok\n");
+            binary_mode = 1;
+            bp_parser_reset(&bp_in);
+            break;
         case 'h':
         case '?':
-            putstr("\nPIC18F46Q71-I/P X2-trigger+timer commands and registers\n");
-            putstr("\n");
-            putstr("Commands:\n");
-            putstr(" h or ? print this help message\n");
-            putstr(" v      report version of firmware\n");
-            putstr(" n      report number of registers\n");
-            putstr(" p      report register values\n");
-            putstr(" r <i>  report value of register i\n");
-            putstr(" s <i> <j>  set register i to value j\n");
-            putstr(" R      restore register values from EEPROM\n");
-            putstr(" S      save register values to EEPROM\n");
-            putstr(" F      set register values to original values\n");
-            putstr(" a      arm device and wait for event\n");
-            // Get ADC Positive Input Channel Selections from Table 41-7 in the data sheet
-            putstr(" c <i>  convert analogue channel i (12-bit result, 0-4095)\n");
-            putstr("        i=57 DAC2_output (INa)\n");
-            putstr("        i=58 DAC3_output (INb)\n");
-            putstr("        i=0  RA0/C1IN0- (INa)\n");
-            putstr("        i=9  RB1/C2IN3- (INb)\n");
-            putstr("\n");
-            putstr("Registers:\n");
-            putstr(" 0  mode: 0= simple trigger from INa signal\n");
-            putstr("          1= time-of-flight(TOF) trigger\n");
-            putstr(" 1  trigger level for INa as an 8-bit count, 0-255\n");
-            putstr(" 2  trigger level for INb as an 8-bit count, 0-255\n");
-            putstr(" 3  Vref selection for DACs 0=off, 1=1v024, 2=2v048, 3=4v096\n");
-            putstr(" 4  delay 0 as 16-bit count (8 ticks per us)\n");
-            putstr(" 5  delay 1 as 16-bit count (8 ticks per us)\n");
-            putstr(" 6  delay 2 as 16-bit count (8 ticks per us)\n");
+            uart1_putrom(help_text, sizeof(help_text)-1);
+            reply_register_help();
             putstr("ok\n");
             break;
         default:
-            nchar = snprintf(bufB, NBUFB, "Error, unknown command: '%c'\n", cmdStr[0]);
-            putstr(bufB);
+            putstr("Error, unknown command: '");
+            putch(cmdStr[0]);
+            putstr("'\n");
     }
+    PROBE_END(PROBE_COMMAND);
 } // end interpret_command()
 
+#define MAXTAG 8
+
+void interpret_tagged_command(char* cmdStr)
+// A command line may start with a sequence tag, #<t>, so that
+// the supervisory PC can send several commands without waiting
+// and then match each reply to its command.
+// The tag is echoed, followed by a space, at the start of the reply.
+{
+    if (cmdStr[0] == '#') {
+        uint8_t n = 0;
+        while (cmdStr[n] && cmdStr[n] != ' ' && n <= MAXTAG) {
+            putch(cmdStr[n]);
+            n++;
+        }
+        putch(' ');
+        if (cmdStr[n] && cmdStr[n] != ' ') {
+            putstr("tag too long. fail\n");
+            return;
+        }
+        while (cmdStr[n] == ' ') n++;
+        cmdStr = &cmdStr[n];
+    }
+    if (cmdStr[0] == '\0') {
+        // Only a tag or an address, but the PC still expects a reply.
+        putstr("Error, no command\n");
+        return;
+    }
+    interpret_command(cmdStr);
+}
+
+void interpret_addressed_command(char* cmdStr)
+// On a multidrop bus, a command line starts with @<n> for node n
+// or @* for all nodes. Nodes stay silent for lines addressed elsewhere,
+// so that the supervisory PC can poll each node in turn.
+// A node acts on broadcast lines without replying,
+// because the nodes would otherwise talk over each other.
+// The exception is 'A', which is acknowledged in turn.
+// A node with address 0 also acts on unaddressed lines,
+// as it would when connected point-to-point.
+{
+    uint8_t my_address = (uint8_t)vregister[8];
+    if (cmdStr[0] != '@') {
+        if (my_address == 0) interpret_tagged_command(cmdStr);
+        return;
+    }
+    uint8_t n = 1;
+    if (cmdStr[1] == '*') {
+        n = 2;
+        while (cmdStr[n] == ' ') n++;
+        uart1_mute(1);
+        broadcast_command = 1;
+        interpret_tagged_command(&cmdStr[n]);
+        broadcast_command = 0;
+        uart1_mute(0);
+        return;
+    }
+    uint16_t address = 0;
+    while (cmdStr[n] >= '0' && cmdStr[n] <= '9') {
+        address = address*10 + (uint16_t)(cmdStr[n] - '0');
+        n++;
+    }
+    if (n == 1 || address != my_address) return;
+    // Echo the address so that replies identify their node.
+    for (uint8_t k=0; k < n; k++) putch(cmdStr[k]);
+    putch(' ');
+    while (cmdStr[n] == ' ') n++;
+    interpret_tagged_command(&cmdStr[n]);
+}
+
+#define ARMED_LINE_KEEP 0 // leave it until after the event
+#define ARMED_LINE_TAKE 1 // a status query to act on now
+#define ARMED_LINE_DROP 2 // for another node, to be ignored anyway
+
+uint8_t armed_line_action(const char* s)
+// Decide what to do with a queued line while armed,
+// looking past the address and tag as the interpreter would.
+{
+    uint8_t my_address = (uint8_t)vregister[8];
+    uint8_t n = 0;
+    if (s[0] == '@') {
+        n = 1;
+        if (s[1] == '*') {
+            n = 2;
+        } else {
+            uint16_t address = 0;
+            while (s[n] >= '0' && s[n] <= '9') {
+                address = address*10 + (uint16_t)(s[n] - '0');
+                n++;
+            }
+            if (n == 1 || address != my_address) return ARMED_LINE_DROP;
+        }
+    } else if (my_address != 0) {
+        return ARMED_LINE_DROP;
+    }
+    while (s[n] == ' ') n++;
+    if (s[n] == '#') {
+        while (s[n] && s[n] != ' ') n++;
+        while (s[n] == ' ') n++;
+    }
+    if (s[n] == 'x' && (s[n+1] == '\0' || s[n+1] == ' ')) return ARMED_LINE_TAKE;
+    return ARMED_LINE_KEEP;
+}
+
+void armed_status_service(void)
+// While armed after 'A', answer the status queries at the front
+// of the line queue, so that the supervisory PC can keep polling,
+// and pass over lines for other nodes.
+// Any other command waits, in order, until after the event.
+{
+    const char* line;
+    while ((line = uart1_peek_line()) != 0) {
+        uint8_t action = armed_line_action(line);
+        if (action == ARMED_LINE_KEEP) return;
+        if (action == ARMED_LINE_DROP) {
+            uart1_drop_line();
+            continue;
+        }
+        // bufA is free: the arming command has been taken from it.
+        getstr(bufA, NBUFA);
+        uint8_t broadcast = broadcast_command;
+        broadcast_command = 0;
+        uart1_mute(0);
+        interpret_addressed_command(bufA);
+        uart1_mute(1); // the outcome of the arming is still not reported
+        broadcast_command = broadcast;
+    }
+}
+
+void send_binary_reply(uint8_t opcode, uint8_t len)
+{
+    uint8_t n = bp_encode(bp_frame, opcode | BP_REPLY, bp_reply, len);
+    for (uint8_t i=0; i < n; i++) putch((char)bp_frame[i]);
+}
+
+void interpret_binary_frame(uint8_t opcode, uint8_t* payload, uint8_t len)
+// The binary counterpart of interpret_command().
+// Each request gets exactly one reply frame, starting with a status byte.
+{
+    uint8_t i, flag;
+    int16_t v;
+    uint16_t u;
+    uint8_t n = 1; // reply payload length so far
+    bp_reply[0] = BP_OK;
+    switch (opcode) {
+        case BP_OP_VERSION:
+            for (i=0; VERSION_STR[i] && n < BP_MAXPAYLOAD; i++) {
+                bp_reply[n++] = (uint8_t)VERSION_STR[i];
+            }
+            break;
+        case BP_OP_NUMREG:
+            bp_reply[n++] = NUMREG;
+            break;
+        case BP_OP_READALL:
+            bp_reply[n++] = NUMREG;
+            for (i=0; i < NUMREG; i++) {
+                bp_reply[n++] = (uint8_t)(vregister[i] & 0x00FF);
+                bp_reply[n++] = (uint8_t)((vregister[i] >> 8) & 0x00FF);
+            }
+            break;
+        case BP_OP_READ:
+        case BP_OP_WRITE:
+            if (len != ((opcode == BP_OP_READ) ? 1 : 3)) {
+                bp_reply[0] = BP_ERR_LENGTH;
+                break;
+            }
+            i = payload[0];
+            if (i >= NUMREG) {
+                bp_reply[0] = BP_ERR_REGISTER;
+                break;
+            }
+            if (opcode == BP_OP_WRITE) {
+                // The node address stays 0 while frames carry none.
+                if (register_read_only(i) || i == 8) {
+                    bp_reply[0] = BP_ERR_READONLY;
+                    break;
+                }
+                v = (int16_t)(payload[1] | (payload[2] << 8));
+                if (!register_value_allowed(i, (register_schema[i].max > 32767) ? (uint16_t)v : v)) {
+                    bp_reply[0] = BP_ERR_RANGE;
+                    break;
+                }
+                set_register(i, v);
+            }
+            v = vregister[i];
+            bp_reply[n++] = i;
+            bp_reply[n++] = (uint8_t)(v & 0x00FF);
+            bp_reply[n++] = (uint8_t)((v >> 8) & 0x00FF);
+            break;
+        case BP_OP_RESTORE:
+            restore_registers_from_EEPROM();
+            // A saved node address puts us back on the multidrop bus,
+            // so this reply is the last frame.
+            if (vregister[8] != 0) binary_mode = 0;
+            break;
+        case BP_OP_SAVE:
+            save_registers_to_EEPROM();
+            break;
+        case BP_OP_FACTORY:
+            set_registers_to_original_values();
+            break;
+        case BP_OP_ARM:
+            timer0_start(ARM_TIMER_CKPS); // for the baseline tracking
+            if (vregister[0] == 0) {
+                flag = trigger_simple();
+            } else if (vregister[0] == 1) {
+                flag = trigger_TOF();
+            } else {
+                bp_reply[0] = BP_ERR_MODE;
+                T0CON0bits.EN = 0;
+                break;
+            }
+            stage_shot_record(flag);
+            T0CON0bits.EN = 0;
+            bp_reply[0] = flag;
+            bp_reply[n++] = (uint8_t)vregister[0];
+            bp_reply[n++] = (uint8_t)(last_tof & 0x00FF);
+            bp_reply[n++] = (uint8_t)(last_tof >> 8);
+            bp_reply[n++] = (uint8_t)(last_pr_value & 0x00FF);
+            bp_reply[n++] = (uint8_t)(last_pr_value >> 8);
+            break;
+        case BP_OP_ADC:
+            if (len != 1) {
+                bp_reply[0] = BP_ERR_LENGTH;
+            } else if (!ADC_channel_allowed(payload[0])) {
+                bp_reply[0] = BP_ERR_CHANNEL;
+            } else {
+                update_PGAs();
+                u = ADC_read_input(payload[0]);
+                bp_reply[n++] = (uint8_t)(u & 0x00FF);
+                bp_reply[n++] = (uint8_t)(u >> 8);
+            }
+            break;
+        case BP_OP_STATUS:
+            n += put_status_record(&bp_reply[n]);
+            break;
+        case BP_OP_EXIT:
+            binary_mode = 0;
+            break;
+        default:
+            bp_reply[0] = BP_ERR_OPCODE;
+    }
+    send_binary_reply(opcode, n);
+} // end interpret_binary_frame()
+
+void binary_service(void)
+// Feed received bytes to the frame parser and act on complete frames.
+// After a shot, return so that the main loop writes it to the journal
+// before any further frames are taken.
+{
+    while (binary_mode && !journal_pending() && uart1_rx_available()) {
+        uint8_t r = bp_parser_feed(&bp_in, (uint8_t)uart1_getch());
+        if (r == BP_FRAME_READY) {
+            interpret_binary_frame(bp_in.opcode, bp_in.payload, bp_in.len);
+        } else if (r == BP_FRAME_BADCRC) {
+            bp_reply[0] = BP_ERR_CRC;
+            send_binary_reply(bp_in.opcode, 1);
+        }
+    }
+}
+
 int main(void)
 {
     int m;
-    int n;
+    // Time the start-up with 32us ticks, rolling over after 2.1s,
+    // which is longer than the 1.1s of the slow start-up.
+    // The power-up timer and C start-up code come before this.
+    timer0_start(0b1001); // 1:512
+    reset_cause = read_reset_cause();
     init_pins();
-    uart1_init(115200);
     restore_registers_from_EEPROM();
-    __delay_ms(10);
-    update_FVRs();
-    update_DACs();
-    ADC_init();
-    __delay_ms(10);
-    // Flash LED twice at start-up to indicate that the MCU is ready.
-    for (int8_t i=0; i < 2; ++i) {
-        LED0 = 1;
-        __delay_ms(250);
-        LED0 = 0;
-        __delay_ms(250);
-    }
-    // Wait until we are reasonably sure that the MCU has restarted
-    // and then flush the incoming serial buffer.
-    __delay_ms(100);
-    uart1_flush_rx();
+    journal_init();
+    uart1_init(selected_baud_rate());
+    if (vregister[10] == 1) {
+        // Fast boot, so that a node that resets in the middle of
+        // a campaign is back before the PC gives up on it.
+        // update_FVRs() waits for FVR RDY, and the DACs and ADC
+        // are usable as soon as they are on.
+        update_FVRs();
+        update_DACs();
+        update_PGAs();
+        ADC_init();
+        // Discard whatever arrived while we were in reset,
+        // but let a character in flight finish first.
+        uart1_wait_rx_idle();
+        uart1_flush_rx();
+    } else {
+        __delay_ms(10);
+        update_FVRs();
+        update_DACs();
+        update_PGAs();
+        ADC_init();
+        __delay_ms(10);
+        // Flash LED twice at start-up to indicate that the MCU is ready.
+        for (int8_t i=0; i < 2; ++i) {
+            LED0 = 1;
+            __delay_ms(250);
+            LED0 = 0;
+            __delay_ms(250);
+        }
+        // Wait until we are reasonably sure that the MCU has restarted
+        // and then flush the incoming serial buffer.
+        __delay_ms(100);
+        uart1_flush_rx();
+    }
+    boot_time_us = (uint32_t)timer0_ticks() * 32;
+    T0CON0bits.EN = 0;
+    uptime_start(boot_time_us / UPTIME_TICK_US);
+    uart1_set_wait_hook(uptime_wait_hook);
+    PROFILE_INIT();
     // We will operate the MCU as a slave, waiting for commands
     // and only responding then.
     LED0 = 1;  // Indicate that we are running. 
@@ -998,10 +3433,25 @@ int main(void)
         // Characters are not echoed as they are typed.
         // Backspace deleting is allowed.
         // CR signals end of incoming command string.
-        m = getstr(bufA, NBUFA);
-        if (m > 0) {
-            interpret_command(bufA);
+        // Characters arriving while we are busy are collected by DMA
+        // and assembled into lines, so we only deal with complete lines.
+        // In binary mode, the bytes go to the frame parser instead.
+        if (binary_mode) {
+            binary_service();
+            uart1_tx_service();
+        } else if (uart1_line_ready()) {
+            m = getstr(bufA, NBUFA);
+            if (m > 0) {
+                interpret_addressed_command(bufA);
+            }
+        }
+        if (journal_pending()) {
+            // Let the reply out before the CPU stalls for the flash write.
+            uart1_tx_flush();
+            journal_service();
         }
+        uptime_service();
+        CLRWDT();
     }
     ADC_close();
     FVR_close();
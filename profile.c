@@ -0,0 +1,119 @@
+// profile.c
+// Probe clock and counts for profile.h.
+//
+// Timer3 counts instruction cycles, FOSC/4 at 1:1, and the count is
+// extended to 32 bits in software, as the uptime is, so a roll-over
+// is only seen if the clock is read at least once per 65536 cycles
+// (4.1ms). The probes read it, as do PROFILE_SERVICE() in
+// uptime_service() and in the EEPROM write wait. A probe whose path
+// stalls for longer than that without reading it, as in a flash erase,
+// comes out short by whole roll-overs.
+//
+// Timer3 also holds the pulse-train window and counts comparator edges
+// for 'N'. Those take the clock over and restart it when they are done,
+// and a probe that was running meanwhile is not counted.
+// The cost of a probe itself is measured at start-up and taken off.
+//
+// 2026-10-18 First cut.
+
+#include "profile.h"
+
+#ifdef X2_PROFILE
+#include <xc.h>
+
+const char* const probe_names[NPROBES] = {
+    "command", "getstr", "eeprom-save", "simple-setup",
+    "tof-setup", "arm-analog", "route"
+};
+
+static probe_stats_t stats[NPROBES];
+static uint32_t clock_high = 0; // whole roll-overs, in cycles
+static uint16_t clock_last = 0;
+static uint8_t clock_running = 0;
+static uint8_t clock_epoch = 0; // changes whenever the clock restarts
+static uint32_t overhead = 0; // cycles counted by an empty probe
+
+void profile_clock_start(void)
+{
+    // As for Timer1 in the data sheet, which Timer3 matches.
+    T3CONbits.ON = 0;
+    T3CLKbits.CS = 0b00001; // FOSC/4
+    T3CONbits.CKPS = 0b00; // 1:1, one count per instruction cycle
+    T3CONbits.RD16 = 1;
+    T3GCONbits.GE = 0; // count continuously
+    TMR3 = 0;
+    clock_high = 0;
+    clock_last = 0;
+    clock_epoch++;
+    clock_running = 1;
+    T3CONbits.ON = 1;
+}
+
+void profile_clock_lost(void)
+{
+    clock_running = 0;
+    clock_epoch++;
+}
+
+uint32_t profile_now(void)
+{
+    if (!clock_running) return 0;
+    uint16_t t = TMR3;
+    if (t < clock_last) clock_high += 0x10000UL;
+    clock_last = t;
+    return clock_high + t;
+}
+
+void profile_begin(probe_t* p)
+{
+    p->epoch = clock_epoch;
+    p->start = profile_now();
+}
+
+void profile_end(uint8_t id, const probe_t* p)
+{
+    uint32_t now = profile_now();
+    if (!clock_running || p->epoch != clock_epoch) return;
+    uint32_t c = now - p->start;
+    c = (c > overhead) ? c - overhead : 0;
+    probe_stats_t* s = &stats[id];
+    s->last = c;
+    if (s->count == 0 || c < s->min) s->min = c;
+    if (c > s->max) s->max = c;
+    if (s->count < 0xFFFF) s->count++;
+}
+
+void profile_cancel(probe_t* p)
+{
+    p->epoch = (uint8_t)(clock_epoch - 1);
+}
+
+uint8_t profile_read(uint8_t i, probe_stats_t* s)
+{
+    if (i >= NPROBES) return 0;
+    *s = stats[i];
+    return 1;
+}
+
+void profile_reset(void)
+{
+    for (uint8_t i=0; i < NPROBES; ++i) {
+        stats[i].last = 0;
+        stats[i].min = 0;
+        stats[i].max = 0;
+        stats[i].count = 0;
+    }
+}
+
+void profile_init(void)
+{
+    profile_clock_start();
+    overhead = 0;
+    probe_t p;
+    profile_begin(&p);
+    profile_end(0, &p);
+    overhead = stats[0].last;
+    profile_reset();
+}
+
+#endif
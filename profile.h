@@ -0,0 +1,84 @@
+// profile.h
+// Probes for timing the hot paths in instruction cycles (62.5ns at 64MHz),
+// with the last, least and greatest count for each kept in SRAM.
+// Build with X2_PROFILE defined to have them; otherwise the macros
+// below are empty and the probes cost nothing.
+//
+// A probe is a pair, PROBE_BEGIN(id) and PROBE_END(id), in one block.
+// A path that leaves between them, such as a failed set-up,
+// is not counted, and neither is one during which the probe clock
+// was taken over (see profile.c).
+//
+// 2026-10-18 First cut.
+
+#ifndef MY_PROFILE
+#define MY_PROFILE
+#include <stdint.h>
+
+// Probe points.
+#define PROBE_COMMAND 0      // interpret_command(), other than arming
+#define PROBE_GETSTR 1       // getstr(), once a line is ready
+#define PROBE_EEPROM_SAVE 2  // save_registers_to_EEPROM()
+#define PROBE_SIMPLE_SETUP 3 // trigger_simple(), from entry to armed
+#define PROBE_TOF_SETUP 4    // trigger_TOF(), from entry to armed
+#define PROBE_ARM_ANALOG 5   // arm_plan_apply_analog()
+#define PROBE_ROUTE 6        // route_outputs()
+#define NPROBES 7
+
+#ifdef X2_PROFILE
+
+typedef struct {
+    uint32_t last; // cycles
+    uint32_t min;
+    uint32_t max;
+    uint16_t count; // stops at 65535
+} probe_stats_t;
+
+typedef struct {
+    uint32_t start;
+    uint8_t epoch;
+} probe_t;
+
+extern const char* const probe_names[NPROBES];
+
+// Start the probe clock and clear the counts; call once after reset.
+void profile_init(void);
+
+// Cycles since the probe clock started, 0 while it is taken over.
+uint32_t profile_now(void);
+
+void profile_begin(probe_t* p);
+void profile_end(uint8_t id, const probe_t* p);
+void profile_cancel(probe_t* p);
+
+// The peripherals that share the probe clock say when they take it
+// and when they are done with it.
+void profile_clock_lost(void);
+void profile_clock_start(void);
+
+// Copy the counts for probe i; returns 0 if i is not a probe.
+uint8_t profile_read(uint8_t i, probe_stats_t* s);
+
+// Clear the counts.
+void profile_reset(void);
+
+#define PROBE_BEGIN(id) probe_t probe_##id; profile_begin(&probe_##id)
+#define PROBE_END(id) profile_end(id, &probe_##id)
+#define PROBE_CANCEL(id) profile_cancel(&probe_##id)
+#define PROFILE_INIT() profile_init()
+#define PROFILE_SERVICE() profile_now()
+#define PROFILE_CLOCK_LOST() profile_clock_lost()
+#define PROFILE_CLOCK_RESTART() profile_clock_start()
+
+#else
+
+#define PROBE_BEGIN(id)
+#define PROBE_END(id)
+#define PROBE_CANCEL(id)
+#define PROFILE_INIT()
+#define PROFILE_SERVICE()
+#define PROFILE_CLOCK_LOST()
+#define PROFILE_CLOCK_RESTART()
+
+#endif
+#endif
@@ -0,0 +1,90 @@
+// reply.c
+// Decimal formatting by repeated subtraction of powers of ten,
+// which is much cheaper on the PIC18 than the division
+// that the library formatter does for every digit.
+//
+// 2026-10-18 Replace the C99 library printf family in replies.
+//            Fixed-width hexadecimal, by shifting, for the status record.
+
+#include <stdint.h>
+#include "uart.h"
+#include "reply.h"
+
+const uint16_t pow10_16[4] = {10000, 1000, 100, 10};
+const uint32_t pow10_32[9] = {1000000000UL, 100000000UL, 10000000UL,
+    1000000UL, 100000UL, 10000UL, 1000UL, 100UL, 10UL};
+
+void reply_uint(uint16_t v)
+{
+    uint8_t started = 0;
+    for (uint8_t i=0; i < 4; i++) {
+        char d = '0';
+        while (v >= pow10_16[i]) { v -= pow10_16[i]; d++; }
+        if (started || d != '0') {
+            putch(d);
+            started = 1;
+        }
+    }
+    putch((char)('0' + v));
+}
+
+void reply_int(int16_t v)
+{
+    if (v < 0) {
+        putch('-');
+        // Negate as unsigned so that -32768 comes out correctly.
+        reply_uint((uint16_t)(0u - (uint16_t)v));
+    } else {
+        reply_uint((uint16_t)v);
+    }
+}
+
+void reply_ulong(uint32_t v)
+{
+    uint8_t started = 0;
+    for (uint8_t i=0; i < 9; i++) {
+        char d = '0';
+        while (v >= pow10_32[i]) { v -= pow10_32[i]; d++; }
+        if (started || d != '0') {
+            putch(d);
+            started = 1;
+        }
+    }
+    putch((char)('0' + v));
+}
+
+void reply_long(int32_t v)
+{
+    if (v < 0) {
+        putch('-');
+        reply_ulong(0UL - (uint32_t)v);
+    } else {
+        reply_ulong((uint32_t)v);
+    }
+}
+
+void reply_hex(uint32_t v, uint8_t ndigits)
+{
+    while (ndigits > 0) {
+        ndigits--;
+        uint8_t d = (uint8_t)((v >> (4*ndigits)) & 0x0F);
+        putch((char)((d < 10) ? ('0' + d) : ('A' - 10 + d)));
+    }
+}
+
+void reply_int_ok(int16_t v)
+{
+    reply_int(v);
+    putstr(" ok\n");
+}
+
+void reply_register(uint8_t i, int32_t v, const char* name)
+{
+    putstr("reg[");
+    reply_uint(i);
+    putstr("]=");
+    reply_long(v);
+    putstr(" (");
+    putstr(name);
+    putstr(")\n");
+}
@@ -0,0 +1,23 @@
+// reply.h
+// Small formatters for the fixed reply texts of the command interpreter,
+// writing decimal numbers directly through putch()
+// so that the firmware needs neither printf nor a line buffer.
+//
+// 2026-10-18 Replace the C99 library printf family in replies.
+//            Fixed-width hexadecimal for the status record.
+
+#ifndef MY_REPLY
+#define MY_REPLY
+#include <stdint.h>
+
+void reply_uint(uint16_t v);
+void reply_int(int16_t v);
+void reply_ulong(uint32_t v);
+void reply_long(int32_t v);
+void reply_hex(uint32_t v, uint8_t ndigits); // fixed width, leading zeros
+
+// Fixed formats that occur more than once.
+void reply_int_ok(int16_t v); // "%d ok\n"
+void reply_register(uint8_t i, int32_t v, const char* name); // "reg[%d]=%ld (%s)\n"
+
+#endif
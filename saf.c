@@ -0,0 +1,75 @@
+// saf.c Storage Area Flash access, following eeprom.c.
+// 2026-10-18 For the shot journal.
+//            Reading the Device Information Area.
+//            Row writes through the buffer RAM.
+
+#include <xc.h>
+#include <stdint.h>
+#include "saf.h"
+
+static void SAF_SetAddress(uint32_t addr)
+{
+    NVMADRU = (uint8_t)((addr >> 16) & 0xFF);
+    NVMADRH = (uint8_t)((addr >> 8) & 0xFF);
+    NVMADRL = (uint8_t)(addr & 0xFF);
+}
+
+static void SAF_Unlock_And_Go(uint8_t cmd)
+{
+    uint8_t GIEBitValue = INTCON0bits.GIE;
+    INTCON0bits.GIE = 0;
+    NVMCON1bits.CMD = cmd;
+    NVMLOCK = 0x55;
+    NVMLOCK = 0xAA;
+    NVMCON0bits.GO = 1;
+    while (NVMCON0bits.GO) /* wait */ ;
+    INTCON0bits.GIE = GIEBitValue;
+    // Disable NVM write and erase commands.
+    NVMCON1bits.CMD = 0b000;
+}
+
+uint16_t SAF_ReadWord(uint32_t addr)
+// See PIC18F46Q71 data sheet, section 10.3.1, reading a word
+{
+    SAF_SetAddress(addr);
+    NVMCON1bits.CMD = 0b000;
+    NVMCON0bits.GO = 1;
+    while (NVMCON0bits.GO) /* wait */ ;
+    return (uint16_t)((NVMDATH << 8) | NVMDATL);
+}
+
+void SAF_WriteWord(uint32_t addr, uint16_t data)
+// See PIC18F46Q71 data sheet, section 10.3.4, writing a word
+{
+    SAF_SetAddress(addr);
+    NVMDATL = (uint8_t)(data & 0xFF);
+    NVMDATH = (uint8_t)(data >> 8);
+    SAF_Unlock_And_Go(0b011);
+}
+
+void SAF_WriteRow(uint32_t addr, const uint16_t* words, uint8_t n)
+// See PIC18F46Q71 data sheet, section 10.3.5, writing a page
+{
+    volatile uint8_t* buf = (volatile uint8_t*)SAF_BUFFER_RAM;
+    uint16_t first = (uint16_t)(addr & (SAF_PAGE_SIZE - 1));
+    for (uint16_t i=0; i < SAF_PAGE_SIZE; ++i) buf[i] = 0xFF;
+    for (uint8_t i=0; i < n; ++i) {
+        buf[first + 2*i] = (uint8_t)(words[i] & 0xFF);
+        buf[first + 2*i + 1] = (uint8_t)(words[i] >> 8);
+    }
+    SAF_SetAddress(addr & ~(uint32_t)(SAF_PAGE_SIZE - 1));
+    SAF_Unlock_And_Go(0b101);
+}
+
+void SAF_ErasePage(uint32_t addr)
+// See PIC18F46Q71 data sheet, section 10.3.3, erasing a page
+{
+    SAF_SetAddress(addr);
+    SAF_Unlock_And_Go(0b110);
+}
+
+uint16_t DIA_ReadWord(uint32_t addr)
+// The DIA is read in the same way, see section 10.3.1
+{
+    return SAF_ReadWord(addr);
+}
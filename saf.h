@@ -0,0 +1,94 @@
+// saf.h Access to the Storage Area Flash, in the manner of eeprom.h.
+// 2026-10-18 For the shot journal.
+//            Calibration words from the Device Information Area.
+//            Row writes through the buffer RAM.
+//
+// With SAFSZ = SAFSZ_1024 in the configuration bits, the SAF is the
+// top 1024 words (2kB) of program flash, kept clear of the application.
+// See PIC18F46Q71 data sheet, section 10.3 and Figure 9-1.
+#ifndef MY_SAF
+#define MY_SAF
+#include <stdint.h>
+
+#define SAF_START 0xF800UL
+#define SAF_SIZE 0x0800U
+#define SAF_PAGE_SIZE 256U // bytes in an erase page of 128 words
+
+/**
+  @Summary
+    Reads a word from the SAF
+
+  @Param
+    addr - byte address of the word, even, SAF_START and up
+
+  @Returns
+    The word; an erased word reads as 0xFFFF
+*/
+uint16_t SAF_ReadWord(uint32_t addr);
+
+/**
+  @Summary
+    Writes a word to the SAF
+
+  @Description
+    Programming can only clear bits, so the word should be erased.
+    The CPU stalls until the write is complete.
+
+  @Param
+    addr - byte address of the word, even
+    data - the word to write
+*/
+void SAF_WriteWord(uint32_t addr, uint16_t data);
+
+/**
+  @Summary
+    Writes several words of one page to the SAF in a single operation
+
+  @Description
+    The words are placed in the NVM buffer RAM, with all the other words
+    of the page left as ones, which programming does not change,
+    and the page is written at once. The words must not cross the end
+    of the page and should be erased. The CPU stalls until the write
+    is complete, for about as long as a single word takes.
+
+  @Param
+    addr - byte address of the first word, even
+    words - the words to write
+    n - how many, 1 to SAF_PAGE_SIZE/2
+*/
+void SAF_WriteRow(uint32_t addr, const uint16_t* words, uint8_t n);
+
+/**
+  @Summary
+    Erases the page containing the given address, to all ones
+*/
+void SAF_ErasePage(uint32_t addr);
+
+// The NVM buffer RAM, which holds one page for a page write or read.
+// Check the address against the data memory map in the data sheet.
+#ifndef SAF_BUFFER_RAM
+#define SAF_BUFFER_RAM 0x2500U
+#endif
+
+// Calibration words in the Device Information Area, Section 9.2 of the
+// data sheet, in case the device header does not name them.
+#ifndef DIA_TSLR2
+#define DIA_TSLR2 0x2C0114UL // temperature indicator, low range: ADC count
+                             // at 90C against the 2.048V FVR, 12-bit
+#endif
+#ifndef DIA_FVRA1X
+#define DIA_FVRA1X 0x2C0118UL // ADC FVR buffer 1 at 1x, in mV
+#endif
+
+/**
+  @Summary
+    Reads a word from the Device Information Area
+
+  @Param
+    addr - byte address of the word, e.g. DIA_FVRA1X
+
+  @Returns
+    The word; 0xFFFF if it was never programmed
+*/
+uint16_t DIA_ReadWord(uint32_t addr);
+#endif
@@ -5,20 +5,231 @@
 // PJ,
 // 2023-12-01 PIC18F16Q41 attached to a MAX3082 RS485 transceiver
 // 2024-07-01 PIC18F46Q71 attached to a TTL-232-5V cable.
+// 2026-10-18 Transmit through a ring buffer that DMA1 feeds to U1TXB.
+//            Receive into a ring buffer by DMA2 and assemble command lines.
+//            Queue enough lines for a pipelined set-up-and-arm sequence.
+//            RS485 build option with hardware transmit-enable.
+//            Change of baud rate on the fly, up to 4Mbaud.
+//            Count receive errors for the status record.
+//            Probe on getstr().
+//            Hook for the caller's counters in the blocking waits.
+//            Count ring overruns, dropping the line that they damage.
 
 #include <xc.h>
 #include "global_defs.h"
 #include "uart.h"
+#include "profile.h"
 #include <stdio.h>
 #include <string.h>
 
+// DMA trigger sources are given as interrupt vector numbers.
+// See the interrupt vector table in the PIC18F46Q71 data sheet.
+#define IRQ_U1RX 0x20
+#define IRQ_U1TX 0x21
+
+// Outgoing characters are queued in a ring buffer and
+// contiguous blocks of the ring are handed to DMA1,
+// which writes them to U1TXB as the UART asks for them.
+// The slots from tx_tail to tx_head are occupied;
+// the first tx_inflight of those belong to the DMA block in progress.
+#define NTXRING 512
+char txring[NTXRING];
+uint16_t tx_head = 0;
+uint16_t tx_tail = 0;
+uint16_t tx_inflight = 0;
+uint8_t tx_muted = 0; // nonzero to discard outgoing characters
+
+// Called, with uart1_tx_service(), on each pass of the blocking waits,
+// for whatever the caller must keep going while we wait,
+// such as a software-extended timer count.
+void (*uart1_wait_hook)(void) = 0;
+
+void uart1_set_wait_hook(void (*hook)(void))
+{
+    uart1_wait_hook = hook;
+}
+
+void uart1_wait_step(void)
+{
+    uart1_tx_service();
+    if (uart1_wait_hook) uart1_wait_hook();
+    CLRWDT();
+}
+
+void uart1_tx_dma_init(void)
+{
+    // See PIC18F46Q71 data sheet, Section 15 DMA.
+    DMASELECT = 0; // DMA1
+    DMAnCON0bits.EN = 0;
+    DMAnCON0bits.SIRQEN = 0;
+    DMAnCON1bits.DMODE = 0b00; // destination address unchanged
+    DMAnCON1bits.DSTP = 0;
+    DMAnCON1bits.SMR = 0b00; // source in SFR/GPR space, for now
+    DMAnCON1bits.SMODE = 0b01; // source address incremented
+    DMAnCON1bits.SSTP = 1; // clear SIRQEN at end of block
+    DMAnDSA = (uint16_t)&U1TXB;
+    DMAnDSZ = 1;
+    DMAnSIRQ = IRQ_U1TX; // move a byte whenever the TX buffer has room
+    DMAnAIRQ = 0; // no abort trigger
+    DMAnCON0bits.EN = 1;
+    tx_head = 0;
+    tx_tail = 0;
+    tx_inflight = 0;
+}
+
+// Incoming characters are written by DMA2 into a ring buffer
+// that it wraps around continuously, so nothing is lost while
+// the CPU is busy interpreting a command or waiting for an event,
+// provided that fewer than NRXRING characters arrive meanwhile.
+// uart1_rx_service() assembles the characters into complete lines,
+// which are queued until the main loop collects them with getstr().
+#define NRXRING 256
+char rxring[NRXRING];
+uint16_t rx_tail = 0; // next character to be read from the ring
+
+// A typical pipelined sequence is several register settings then an arm,
+// all sent without waiting for the replies.
+#define NRXLINES 8
+#define NRXLINE 80
+char rxlines[NRXLINES][NRXLINE];
+uint8_t rxline_len[NRXLINES];
+uint8_t rxline_head = 0; // line being assembled
+uint8_t rxline_tail = 0; // oldest complete line
+uint8_t rxline_count = 0; // number of complete lines
+uint8_t rxline_i = 0; // characters in line being assembled
+uint8_t rxline_truncated = 0; // line being assembled has lost characters
+uint8_t rxline_damaged = 0; // and those were lost to a ring overrun
+
+// Receive errors since start-up, each count sticking at 0xFFFF.
+// The UART flags are sampled as the line assembler runs, so a framing
+// error on a character that the DMA has already taken may go uncounted,
+// but a FIFO overflow is latched until we clear it.
+// FERIF is read-only and stays set while the bad character is at the
+// head of the FIFO, so we count it as it goes from clear to set.
+uint16_t rx_framing_errors = 0;
+uint8_t rx_framing_seen = 0; // FERIF as at the last sample
+uint16_t rx_overflow_errors = 0;
+uint16_t rx_truncated_lines = 0; // longer than NRXLINE-1 characters
+// DMA2 never stops, so if we fall behind by a whole ring it writes over
+// characters that we have not yet read. We notice by following its
+// position from one look to the next, and by its count-reload flag,
+// which is set each time it wraps and tells us of a whole lap between
+// two looks. Two laps between looks count as one.
+uint16_t rx_ring_overruns = 0;
+uint16_t rx_last_head = 0; // DMA2 position at the last look
+
+void uart1_rx_dma_init(void)
+{
+    DMASELECT = 1; // DMA2
+    DMAnCON0bits.EN = 0;
+    DMAnCON0bits.SIRQEN = 0;
+    DMAnCON1bits.DMODE = 0b01; // destination address incremented
+    DMAnCON1bits.DSTP = 0; // keep going when the ring wraps
+    DMAnCON1bits.SMR = 0b00; // SFR/GPR space
+    DMAnCON1bits.SMODE = 0b00; // source address unchanged
+    DMAnCON1bits.SSTP = 0;
+    DMAnSSA = (__uint24)&U1RXB;
+    DMAnSSZ = 1;
+    DMAnDSA = (uint16_t)&rxring[0];
+    DMAnDSZ = NRXRING;
+    DMAnSIRQ = IRQ_U1RX; // move a byte whenever one arrives
+    DMAnAIRQ = 0;
+    DMAnCON0bits.EN = 1;
+    DMAnCON0bits.SIRQEN = 1;
+    rx_tail = 0;
+    rxline_head = 0;
+    rxline_tail = 0;
+    rxline_count = 0;
+    rxline_i = 0;
+    rxline_truncated = 0;
+    rxline_damaged = 0;
+    rx_framing_seen = 0;
+    rx_last_head = 0;
+    DMA2DCNTIF = 0;
+}
+
+uint16_t rx_head(void)
+// Index in the ring of the next character to be written by DMA2.
+{
+    uint16_t n1, n2;
+    DMASELECT = 1;
+    // The DMA may update the count between our reading the two bytes.
+    do {
+        n1 = DMAnDCNT;
+        n2 = DMAnDCNT;
+    } while (n1 != n2);
+    return (NRXRING - n1) % NRXRING;
+}
+
+uint16_t uart1_rx_check(void)
+// Index of the next character to be written by DMA2, as rx_head(),
+// having first checked that DMA2 has not overtaken rx_tail.
+// If it has, the oldest characters are gone; we count the overrun
+// and keep the newest, but the line that they belonged to is dropped.
+{
+    uint16_t head = rx_head();
+    uint16_t arrived = (head + NRXRING - rx_last_head) % NRXRING;
+    uint16_t unread = (rx_last_head + NRXRING - rx_tail) % NRXRING;
+    uint8_t lapped = 0;
+    if (DMA2DCNTIF && rx_head() >= head) {
+        // The wrap came before we took head, so it is ours to account for;
+        // one that came just after is left flagged for the next look.
+        DMA2DCNTIF = 0;
+        lapped = (head >= rx_last_head);
+    }
+    rx_last_head = head;
+    if (lapped || unread + arrived >= NRXRING) {
+        if (rx_ring_overruns < 0xFFFF) rx_ring_overruns++;
+        rx_tail = (head + 1) % NRXRING;
+        rxline_damaged = 1;
+    }
+    return head;
+}
+
+unsigned int uart1_brg(long baud)
+{
+    // With BRGS=1, baud = FOSC/(4*(BRG+1)).
+    // Round to the nearest divisor because, at the higher rates,
+    // truncation alone would put us beyond the 2% tolerance.
+    return (unsigned int) ((FOSC/baud + 2)/4 - 1);
+}
+
 void uart1_init(long baud)
 {
     // Follow recipe given in PIC18F46Q71 data sheet
     // Sections 35.2.1.1 and 35.2.2.1
     // We are going to use hardware control for CTSn/RTSn.
-    unsigned int brg_value;
     //
+#ifdef RS485
+    // Configure PPS RX1=RC7, TX1=RC0, TXDE1=RC1, CTS1=RC6
+    // RC1 drives both DE and RE# of the half-duplex transceiver.
+    // The UART asserts TXDE only while it is shifting out data,
+    // so the bus is released at the end of the last stop bit,
+    // without any software in the turnaround.
+    // TXDE needs the hardware flow control, so we hold CTS asserted
+    // by driving the otherwise-unused RC6 low.
+    GIE = 0;
+    PPSLOCK = 0x55;
+    PPSLOCK = 0xaa;
+    PPSLOCKED = 0;
+    U1RXPPS = 0b010111; // RC7
+    U1CTSPPS = 0b010110; // RC6
+    RC0PPS = 0x15; // UART1 TX
+    RC1PPS = 0x16; // UART1 TXDE
+    PPSLOCK = 0x55;
+    PPSLOCK = 0xaa;
+    PPSLOCKED = 1;
+    ANSELCbits.ANSELC0 = 0; // TX pin
+    TRISCbits.TRISC0 = 0; // output
+    ANSELCbits.ANSELC1 = 0; // TXDE pin
+    TRISCbits.TRISC1 = 0; // output
+    ANSELCbits.ANSELC7 = 0; // Turn on digital input buffer for RX1
+    TRISCbits.TRISC7 = 1; // RX1 is an input
+    WPUCbits.WPUC7 = 1; // The transceiver's RO floats while we transmit.
+    LATCbits.LATC6 = 0; // CTS permanently asserted
+    ANSELCbits.ANSELC6 = 0;
+    TRISCbits.TRISC6 = 0;
+#else
     // Configure PPS RX1=RC7, TX1=RC0, RTS1=RC1, CTS1=RC6 
     GIE = 0;
     PPSLOCK = 0x55;
@@ -39,46 +250,235 @@ void uart1_init(long baud)
     TRISCbits.TRISC7 = 1; // RX1 is an input
     ANSELCbits.ANSELC6 = 0; // Turn on digital input buffer for CTS
     TRISCbits.TRISC6 = 1; // RX1 is an input
+#endif
     //
     U1CON0bits.BRGS = 1;
-    brg_value = (unsigned int) (FOSC/baud/4 - 1);
-    // For 64MHz, 115200 baud, expect value of 137.
-    //              9600 baud                 1665.
-    U1BRG = brg_value;
+    U1BRG = uart1_brg(baud);
+    // For 64MHz, 115200 baud, expect value of 138.
+    //              9600 baud                 1666.
+    //           1000000 baud                   15.
     //
     U1CON0bits.MODE = 0b0000; // Use 8N1 asynchronous
-    U1CON2bits.FLO = 0b10; // Hardware flow control (RTS/CTS)
+    U1CON2bits.FLO = 0b10; // Hardware flow control (RTS/CTS and TXDE)
     U1CON0bits.RXEN = 1;
     U1CON0bits.TXEN = 1;
     U1CON1bits.ON = 1;
+    //
+    uart1_tx_dma_init();
+    uart1_rx_dma_init();
+    // The DMA channels need bus priorities before they can run.
+    // Receiving has precedence so that the UART FIFO never overflows.
+    DMA1PR = 0x01;
+    DMA2PR = 0x00;
+    GIE = 0;
+    PRLOCK = 0x55;
+    PRLOCK = 0xaa;
+    PRLOCKbits.PRLOCKED = 1;
     return;
 }
 
+void uart1_tx_service(void)
+// Start the next DMA block if the previous one has finished.
+// This needs to be called often enough to keep the data flowing;
+// uart1_putch() and the receive loops do so.
+{
+    DMASELECT = 0; // DMA1
+    if (DMAnCON0bits.SIRQEN) return; // block still in progress
+    tx_tail = (tx_tail + tx_inflight) % NTXRING;
+    tx_inflight = 0;
+    if (tx_head == tx_tail) return; // nothing more to send
+    // Send up to the end of the ring; any wrapped part goes next time.
+    uint16_t n = (tx_head > tx_tail) ? (tx_head - tx_tail) : (NTXRING - tx_tail);
+    DMAnCON1bits.SMR = 0b00; // GPR
+    DMAnSSA = (__uint24)&txring[tx_tail];
+    DMAnSSZ = n;
+    tx_inflight = n;
+    DMAnCON0bits.SIRQEN = 1;
+}
+
+void uart1_tx_flush(void)
+// Block until all queued characters have gone to the UART.
+{
+    while (tx_head != tx_tail || tx_inflight) { uart1_wait_step(); }
+    DMASELECT = 0;
+    while (DMAnCON0bits.SIRQEN) { uart1_wait_step(); }
+    while (!U1ERRIRbits.TXMTIF) { uart1_wait_step(); }
+}
+
+void uart1_set_baud(long baud)
+// Change the baud rate after everything queued has been sent,
+// then discard whatever arrived during the change.
+{
+    uart1_tx_flush();
+    U1CON1bits.ON = 0;
+    U1BRG = uart1_brg(baud);
+    U1CON1bits.ON = 1;
+    uart1_flush_rx();
+}
+
+void uart1_mute(uint8_t muted)
+// While muted, outgoing characters are discarded.
+// Nodes on a multidrop bus keep quiet this way for broadcast commands.
+{
+    tx_muted = muted;
+}
+
 void uart1_putch(char data)
 {
-    // Wait until shift-register empty, then send data.
-    while (!U1ERRIRbits.TXMTIF) { CLRWDT(); }
-    U1TXB = data;
+    // Queue the character, waiting for room only if the ring is full.
+    if (tx_muted) return;
+    uint16_t next = (tx_head + 1) % NTXRING;
+    while (next == tx_tail) { uart1_wait_step(); }
+    txring[tx_head] = data;
+    tx_head = next;
+    uart1_tx_service();
     return;
 }
 
+void uart1_putrom(const char* str, uint16_t n)
+// Send a long constant text by DMA directly from program flash,
+// without copying it through the ring buffer.
+// Anything already queued goes first and anything queued
+// afterwards waits for the DMA to finish this block.
+{
+    if (n == 0 || tx_muted) return;
+    while (tx_head != tx_tail || tx_inflight) { uart1_wait_step(); }
+    DMASELECT = 0;
+    while (DMAnCON0bits.SIRQEN) { uart1_wait_step(); }
+    DMAnCON1bits.SMR = 0b01; // program flash
+    DMAnSSA = (__uint24)str;
+    DMAnSSZ = n;
+    DMAnCON0bits.SIRQEN = 1;
+}
+
 void uart1_flush_rx(void)
+// Discard everything received so far, including queued lines.
 {
     U1FIFObits.RXBE = 1;
+    DMA2DCNTIF = 0;
+    rx_tail = rx_head();
+    rx_last_head = rx_tail;
+    rxline_head = 0;
+    rxline_tail = 0;
+    rxline_count = 0;
+    rxline_i = 0;
+    rxline_truncated = 0;
+    rxline_damaged = 0;
+}
+
+void uart1_wait_rx_idle(void)
+// Wait until the receive pin is idle, for no longer than
+// a character time at 115200 baud, so that a following flush
+// does not leave us part way through a character.
+{
+    for (uint8_t i=0; i < 100 && !U1FIFObits.RXIDL; ++i) { __delay_us(1); }
+}
+
+uint8_t uart1_rx_available(void)
+{
+    return rx_tail != uart1_rx_check();
 }
 
 char uart1_getch(void)
+// Take the next character straight from the ring.
+// Do not mix with getstr() because the line assembler
+// also consumes characters from the ring.
 {
     char c;
-    // Block until a character is available in buffer.
-    while (U1FIFObits.RXBE) { CLRWDT(); }
+    // Block until a character is available in buffer,
+    // keeping the outgoing data moving while we wait.
+    while (!uart1_rx_available()) { uart1_wait_step(); }
     // Get the data that came in.
-    c = U1RXB;
+    c = rxring[rx_tail];
+    rx_tail = (rx_tail + 1) % NRXRING;
     return c;
 }
 
+void uart1_rx_service(void)
+// Move characters from the ring into the line queue,
+// stopping when the queue of complete lines is full.
+{
+    // U1ERRIR, see Section 35 of the PIC18F46Q71 data sheet.
+    uint8_t ferif = U1ERRIRbits.FERIF;
+    if (ferif && !rx_framing_seen && rx_framing_errors < 0xFFFF) rx_framing_errors++;
+    rx_framing_seen = ferif;
+    if (U1ERRIRbits.RXFOIF) {
+        U1ERRIRbits.RXFOIF = 0;
+        if (rx_overflow_errors < 0xFFFF) rx_overflow_errors++;
+    }
+    uint16_t head = uart1_rx_check();
+    while (rx_tail != head && rxline_count < NRXLINES) {
+        char c = rxring[rx_tail];
+        rx_tail = (rx_tail + 1) % NRXRING;
+        if (c != '\n' && c != '\r' && c != '\b') {
+            if (rxline_i < (NRXLINE-1)) {
+                // Append a normal character.
+                rxlines[rxline_head][rxline_i] = c;
+                rxline_i++;
+            } else if (!rxline_truncated) {
+                // The rest of the line is dropped; count it once.
+                rxline_truncated = 1;
+                if (rx_truncated_lines < 0xFFFF) rx_truncated_lines++;
+            }
+        }
+        if (c == '\r' && rxline_damaged) {
+            // Part of this line was overwritten in the ring; drop it.
+            rxline_i = 0;
+            rxline_truncated = 0;
+            rxline_damaged = 0;
+        } else if (c == '\r') {
+            // A carriage-return character completes the line.
+            rxlines[rxline_head][rxline_i] = '\0';
+            rxline_len[rxline_head] = rxline_i;
+            rxline_head = (rxline_head + 1) % NRXLINES;
+            rxline_count++;
+            rxline_i = 0;
+            rxline_truncated = 0;
+        }
+        if (c == '\b' && rxline_i > 0) {
+            // Backspace.
+            rxline_i--;
+        }
+    }
+    uart1_tx_service();
+}
+
+uint8_t uart1_line_ready(void)
+{
+    uart1_rx_service();
+    return rxline_count > 0;
+}
+
+const char* uart1_peek_line(void)
+// The oldest complete line, left in the queue, or 0 if there is none.
+{
+    if (!uart1_line_ready()) return 0;
+    return rxlines[rxline_tail];
+}
+
+void uart1_drop_line(void)
+{
+    if (rxline_count == 0) return;
+    rxline_tail = (rxline_tail + 1) % NRXLINES;
+    rxline_count--;
+}
+
+void uart1_error_counts(uint16_t* framing, uint16_t* overflow, uint16_t* truncated,
+                        uint16_t* overrun)
+{
+    *framing = rx_framing_errors;
+    *overflow = rx_overflow_errors;
+    *truncated = rx_truncated_lines;
+    *overrun = rx_ring_overruns;
+}
+
 void uart1_close(void)
 {
+    uart1_tx_flush();
+    DMASELECT = 0;
+    DMAnCON0bits.EN = 0;
+    DMASELECT = 1;
+    DMAnCON0bits.EN = 0;
     U1CON0bits.RXEN = 1;
     U1CON0bits.TXEN = 1;
     U1CON1bits.ON = 1;
@@ -108,36 +508,26 @@ int getche(void)
 // Convenience functions for strings.
 
 int getstr(char* buf, int nbuf)
-// Read (without echo) a line of characters into the buffer,
-// stopping when we see a return character.
+// Copy (without echo) the oldest complete line into the buffer,
+// blocking until one has been terminated by a return character.
 // Returns the number of characters collected,
 // excluding the terminating null char.
 {
-    int i = 0;
-    char c;
-    uint8_t done = 0;
-    while (!done) {
-        c = (char)getch();
-        if (c != '\n' && c != '\r' && c != '\b' && i < (nbuf-1)) {
-            // Append a normal character.
-            buf[i] = c;
-            i++;
-        }
-        if (c == '\r') {
-            // Stop collecting on receiving a carriage-return character.
-            done = 1;
-            buf[i] = '\0';
-        }
-        if (c == '\b' && i > 0) {
-            // Backspace.
-            i--;
-        }
-    }
+    int i;
+    while (!uart1_line_ready()) { uart1_wait_step(); }
+    PROBE_BEGIN(PROBE_GETSTR);
+    char* line = rxlines[rxline_tail];
+    int n = rxline_len[rxline_tail];
+    for (i=0; i < n && i < (nbuf-1); i++) { buf[i] = line[i]; }
+    buf[i] = '\0';
+    rxline_tail = (rxline_tail + 1) % NRXLINES;
+    rxline_count--;
+    PROBE_END(PROBE_GETSTR);
     return i;
 }
 
-void putstr(char* str)
+void putstr(const char* str)
 {
-    for (size_t i=0; i < strlen(str); i++) putch(str[i]); 
+    while (*str) putch(*str++);
     return;
 }
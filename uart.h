@@ -1,12 +1,31 @@
 // uart.h
 // PJ, 2023-12-01, 2024-07-01 simplify again for x2-timer.
+// 2026-10-18 DMA-driven transmit and receive.
+//            Receive error counts and a look at the next line.
+//            Hook for the caller's counters in the blocking waits.
+//            Count ring overruns.
 
 #ifndef MY_UART
 #define MY_UART
 void uart1_init(long baud);
+void uart1_set_baud(long baud);
 void uart1_putch(char data);
+void uart1_putrom(const char* str, uint16_t n);
+void uart1_tx_service(void);
+void uart1_tx_flush(void);
+void uart1_set_wait_hook(void (*hook)(void));
+void uart1_mute(uint8_t muted);
 void uart1_flush_rx(void);
+void uart1_wait_rx_idle(void);
+uint8_t uart1_rx_available(void);
 char uart1_getch(void);
+uint16_t uart1_rx_check(void);
+void uart1_rx_service(void);
+uint8_t uart1_line_ready(void);
+const char* uart1_peek_line(void);
+void uart1_drop_line(void);
+void uart1_error_counts(uint16_t* framing, uint16_t* overflow, uint16_t* truncated,
+                        uint16_t* overrun);
 void uart1_close(void);
 
 void putch(char data);
@@ -14,7 +33,7 @@ int getch(void);
 int getche(void);
 
 int getstr(char* buf, int nbuf);
-void putstr(char* str);
+void putstr(const char* str);
 
 #define XON 0x11
 #define XOFF 0x13